@@ -8,8 +8,10 @@
 #include <bloom.h>
 #include <hash.h>
 #include <random.h>
+#include <streams.h>
 #include <uint256.h>
 #include <utiltime.h>
+#include <crypto/common.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -60,6 +62,62 @@ static void SHA256D64_1024(benchmark::State& state)
     }
 }
 
+static void SHA256D32_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(32 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256D32(in.data(), in.data(), 1024);
+    }
+}
+
+/* Number of timestamps a staking wallet tries per output */
+static const unsigned int STAKE_HASH_DRIFT = 180;
+
+static void StakeKernelHash_Stream(benchmark::State& state)
+{
+    const uint64_t nStakeModifier = 0x0123456789abcdef;
+    const unsigned int nTimeBlockFrom = 1500000000;
+    const unsigned int nTxPrevOffset = 80;
+    const int64_t txPrevTime = nTimeBlockFrom;
+    const uint32_t n = 1;
+    const unsigned int nTimeTx = 1500100000;
+    uint256 hash;
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < STAKE_HASH_DRIFT; i++) {
+            CDataStream ss(SER_GETHASH, 0);
+            ss << nStakeModifier;
+            ss << nTimeBlockFrom << nTxPrevOffset << txPrevTime << n << (nTimeTx - i);
+            hash = Hash(ss.begin(), ss.end());
+        }
+    }
+}
+
+static void StakeKernelHash_Batched(benchmark::State& state)
+{
+    const uint64_t nStakeModifier = 0x0123456789abcdef;
+    const unsigned int nTimeBlockFrom = 1500000000;
+    const unsigned int nTxPrevOffset = 80;
+    const int64_t txPrevTime = nTimeBlockFrom;
+    const uint32_t n = 1;
+    const unsigned int nTimeTx = 1500100000;
+    CDataStream ss(SER_GETHASH, 0);
+    ss << nStakeModifier;
+    ss << nTimeBlockFrom << nTxPrevOffset << txPrevTime << n;
+
+    unsigned char in[8 * 32];
+    unsigned char out[8 * 32];
+    for (int j = 0; j < 8; j++)
+        memcpy(in + j * 32, ss.data(), ss.size());
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < STAKE_HASH_DRIFT; i += 8) {
+            size_t nCount = std::min<size_t>(8, STAKE_HASH_DRIFT - i);
+            for (size_t j = 0; j < nCount; j++)
+                WriteLE32(in + j * 32 + 28, nTimeTx - i - j);
+            SHA256D32(out, in, nCount);
+        }
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -103,5 +161,8 @@ BENCHMARK(SHA512, 330);
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(SHA256D32_1024, 14000);
+BENCHMARK(StakeKernelHash_Stream, 25000);
+BENCHMARK(StakeKernelHash_Batched, 80000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -0,0 +1,57 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/stakesim.h>
+
+#include <chain.h>
+
+#include <assert.h>
+
+// Search a wallet of 1000 mature outputs for a coinstake, as the stake minter
+// does for every block; with the default target the first kernel passes.
+static void CreateCoinStake(benchmark::State& state)
+{
+    benchmark::StakeSimulation sim{benchmark::StakeSimulation::Options()};
+
+    while (state.KeepRunning()) {
+        CMutableTransaction txCoinStake;
+        unsigned int nTime = 0;
+        assert(sim.CreateCoinStake(txCoinStake, nTime));
+    }
+}
+
+// Check the kernel of a staked block, as block acceptance does
+static void CheckProofOfStake(benchmark::State& state)
+{
+    benchmark::StakeSimulation sim{benchmark::StakeSimulation::Options()};
+
+    CMutableTransaction txCoinStake;
+    unsigned int nTime = 0;
+    assert(sim.CreateCoinStake(txCoinStake, nTime));
+    const CBlock block = sim.MakeBlock(txCoinStake, nTime);
+
+    while (state.KeepRunning()) {
+        assert(sim.CheckProofOfStake(block));
+    }
+}
+
+// Recompute the stake modifier of consecutive blocks, wrapping around to the
+// start of the range every 500 blocks like a short reorg
+static void ComputeNextStakeModifier(benchmark::State& state)
+{
+    benchmark::StakeSimulation sim{benchmark::StakeSimulation::Options()};
+
+    const int nHeightStart = sim.Tip()->nHeight - 500;
+    int nHeight = nHeightStart;
+    while (state.KeepRunning()) {
+        assert(sim.ComputeStakeModifier(nHeight));
+        if (++nHeight > sim.Tip()->nHeight)
+            nHeight = nHeightStart;
+    }
+}
+
+BENCHMARK(CreateCoinStake, 100);
+BENCHMARK(CheckProofOfStake, 5000);
+BENCHMARK(ComputeNextStakeModifier, 5000);
@@ -0,0 +1,162 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/stakesim.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <kernel.h>
+#include <key.h>
+#include <random.h>
+#include <script/standard.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <wallet/wallet.h>
+
+#include <assert.h>
+
+namespace benchmark {
+
+StakeSimulation::StakeSimulation(const Options& options) : m_options(options)
+{
+    assert(m_options.nBlocks > 1 && m_options.nSpacing > 0);
+    assert(m_options.nMinAge <= m_options.nMaxAge);
+
+    SelectParams(m_options.strNetwork);
+    BuildChain();
+    BuildWallet();
+}
+
+StakeSimulation::~StakeSimulation()
+{
+    m_wallet.reset();
+
+    LOCK(cs_main);
+    pcoinsTip.reset();
+    chainActive.SetTip(nullptr);
+    stakeModifierIndex.Clear();
+    stakeModifierCandidates.Clear();
+    for (CBlockIndex* pindex : m_blocks) {
+        mapBlockIndex.erase(pindex->GetBlockHash());
+        delete pindex;
+    }
+    m_blocks.clear();
+    SetMockTime(0);
+}
+
+const CBlockIndex* StakeSimulation::Tip() const
+{
+    return m_blocks.back();
+}
+
+void StakeSimulation::BuildChain()
+{
+    LOCK(cs_main);
+    FastRandomContext rng(ArithToUint256(arith_uint256(m_options.nSeed)));
+
+    // the tip lands a little before the current time, like a synced node
+    const int64_t nTimeStart = GetTime() - m_options.nBlocks * m_options.nSpacing;
+    for (int nHeight = 0; nHeight < m_options.nBlocks; nHeight++) {
+        CBlockIndex* pindex = new CBlockIndex();
+        BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(rng.rand256(), pindex)).first;
+        pindex->phashBlock = &mi->first;
+        pindex->pprev = m_blocks.empty() ? nullptr : m_blocks.back();
+        pindex->nHeight = nHeight;
+        pindex->nTime = nTimeStart + nHeight * m_options.nSpacing + rng.randrange(m_options.nSpacing / 4 + 1);
+        pindex->nBits = m_options.nBits;
+        if (nHeight > 0 && rng.randbool()) {
+            pindex->SetProofOfStake();
+            pindex->hashProofOfStake = rng.rand256();
+        }
+        pindex->BuildSkip();
+
+        uint64_t nStakeModifier = 0;
+        bool fGeneratedStakeModifier = false;
+        if (!ComputeNextStakeModifier(pindex, nStakeModifier, fGeneratedStakeModifier))
+            throw std::runtime_error("StakeSimulation: ComputeNextStakeModifier failed");
+        pindex->SetStakeModifier(nStakeModifier, fGeneratedStakeModifier);
+        m_blocks.push_back(pindex);
+    }
+    chainActive.SetTip(m_blocks.back());
+
+    // the next block is due
+    SetMockTime(m_blocks.back()->GetBlockTime() + m_options.nSpacing);
+}
+
+void StakeSimulation::BuildWallet()
+{
+    m_wallet.reset(new CWallet("stakesim", WalletDatabase::CreateDummy()));
+    FastRandomContext rng(ArithToUint256(arith_uint256(m_options.nSeed + 1)));
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    LOCK2(cs_main, m_wallet->cs_wallet);
+    m_wallet->LoadKey(key, key.GetPubKey());
+    pcoinsTip.reset(new CCoinsViewCache(&m_coins_dummy));
+
+    const int64_t nTipTime = Tip()->GetBlockTime();
+    const int64_t nTimeFirst = m_blocks[1]->GetBlockTime();
+    for (int i = 0; i < m_options.nCoins; i++) {
+        // confirm each output in the block closest to its age
+        const int64_t nAge = m_options.nMinAge + rng.randrange(m_options.nMaxAge - m_options.nMinAge + 1);
+        const int64_t nHeight = std::max<int64_t>(1, std::min<int64_t>(Tip()->nHeight, 1 + (nTipTime - nAge - nTimeFirst) / m_options.nSpacing));
+        const CBlockIndex* pindex = m_blocks[nHeight];
+
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(COutPoint(rng.rand256(), 0));
+        mtx.vout.emplace_back(m_options.nCoinValue, scriptPubKey);
+
+        CWalletTx wtx(m_wallet.get(), MakeTransactionRef(std::move(mtx)));
+        wtx.SetMerkleBranch(pindex, 1);
+        wtx.nTimeReceived = wtx.nTimeSmart = pindex->GetBlockTime();
+        m_wallet->LoadToWallet(wtx);
+
+        pcoinsTip->AddCoin(COutPoint(wtx.GetHash(), 0), Coin(wtx.tx->vout[0], pindex->nHeight, false, false), false);
+    }
+}
+
+bool StakeSimulation::CreateCoinStake(CMutableTransaction& txCoinStake, unsigned int& nTime)
+{
+    std::vector<const CWalletTx*> vwtxPrev;
+    return m_wallet->CreateCoinStake(*m_wallet, m_options.nBits, 0, txCoinStake, nTime, vwtxPrev, false);
+}
+
+CBlock StakeSimulation::MakeBlock(const CMutableTransaction& txCoinStake, unsigned int nTime) const
+{
+    CMutableTransaction txCoinBase;
+    txCoinBase.vin.resize(1);
+    txCoinBase.vin[0].prevout.SetNull();
+    txCoinBase.vin[0].scriptSig = CScript() << (Tip()->nHeight + 1) << OP_0;
+    txCoinBase.vout.resize(1);
+    txCoinBase.vout[0].SetEmpty();
+
+    CBlock block;
+    block.hashPrevBlock = Tip()->GetBlockHash();
+    block.nTime = nTime;
+    block.nBits = m_options.nBits;
+    block.vtx.push_back(MakeTransactionRef(std::move(txCoinBase)));
+    block.vtx.push_back(MakeTransactionRef(txCoinStake));
+    return block;
+}
+
+bool StakeSimulation::CheckProofOfStake(const CBlock& block) const
+{
+    LOCK(cs_main);
+    uint256 hashProofOfStake;
+    return ::CheckProofOfStake(block, hashProofOfStake, Tip());
+}
+
+bool StakeSimulation::ComputeStakeModifier(int nHeight) const
+{
+    const CBlockIndex* pindex = m_blocks.at(nHeight);
+    uint64_t nStakeModifier;
+    bool fGeneratedStakeModifier;
+    return ::ComputeNextStakeModifier(pindex, nStakeModifier, fGeneratedStakeModifier) &&
+        nStakeModifier == pindex->nStakeModifier;
+}
+
+} // namespace benchmark
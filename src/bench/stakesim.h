@@ -0,0 +1,82 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_STAKESIM_H
+#define BITCOIN_BENCH_STAKESIM_H
+
+#include <amount.h>
+#include <chainparamsbase.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class CBlockIndex;
+class CWallet;
+
+namespace benchmark {
+
+/**
+ * A synthetic proof-of-stake chain and staking wallet, set up in the node's
+ * global chain state (chainActive, mapBlockIndex, pcoinsTip) so the kernel
+ * and wallet staking code can be timed without a data directory or peers.
+ * Block times, stake modifiers and wallet outputs are derived from a fixed
+ * seed so runs are reproducible. Constructing a simulation selects the chain
+ * parameters of Options::strNetwork; only one may exist at a time.
+ */
+class StakeSimulation
+{
+public:
+    struct Options {
+        //! Chain whose consensus parameters (stake age, minimum amount) apply
+        std::string strNetwork = CBaseChainParams::TESTNET;
+        //! Number of blocks in the chain; with nSpacing it must cover nMaxAge
+        int nBlocks = 3000;
+        //! Seconds between blocks
+        int64_t nSpacing = 10 * 60;
+        //! Number of wallet outputs that may stake
+        int nCoins = 1000;
+        //! Value of each wallet output
+        CAmount nCoinValue = 100 * COIN;
+        //! Age of the wallet outputs at the tip, in seconds (uniform in [nMinAge, nMaxAge])
+        int64_t nMinAge = 2 * 24 * 60 * 60;
+        int64_t nMaxAge = 18 * 24 * 60 * 60;
+        //! Stake target; the default lets every kernel pass
+        unsigned int nBits = 0x207fffff;
+        uint64_t nSeed = 0;
+    };
+
+    explicit StakeSimulation(const Options& options);
+    ~StakeSimulation();
+
+    const CBlockIndex* Tip() const;
+
+    /** Search the wallet for a coinstake on top of the tip, as the stake minter does. */
+    bool CreateCoinStake(CMutableTransaction& txCoinStake, unsigned int& nTime);
+
+    /** Build a block on top of the tip around a coinstake from CreateCoinStake. */
+    CBlock MakeBlock(const CMutableTransaction& txCoinStake, unsigned int nTime) const;
+
+    /** Validate the proof-of-stake of a block built on the tip. */
+    bool CheckProofOfStake(const CBlock& block) const;
+
+    /** Recompute the stake modifier of the block at nHeight, as block acceptance does. */
+    bool ComputeStakeModifier(int nHeight) const;
+
+private:
+    Options m_options;
+    CCoinsView m_coins_dummy;
+    std::unique_ptr<CWallet> m_wallet;
+    std::vector<CBlockIndex*> m_blocks;
+
+    void BuildChain();
+    void BuildWallet();
+};
+
+} // namespace benchmark
+
+#endif // BITCOIN_BENCH_STAKESIM_H
@@ -0,0 +1,161 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/stakesim.h>
+
+#include <chain.h>
+#include <crypto/sha256.h>
+#include <key.h>
+#include <random.h>
+#include <util.h>
+#include <utilmoneystr.h>
+#include <utilstrencodings.h>
+#include <wallet/wallet.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const int64_t DEFAULT_SIM_ITERATIONS = 1000;
+
+static void SetupSimArgs(const benchmark::StakeSimulation::Options& defaults)
+{
+    gArgs.AddArg("-?", "Print this help message and exit", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-iterations=<n>", strprintf("Number of timed calls per operation (default: %u)", DEFAULT_SIM_ITERATIONS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-network=<net>", strprintf("Use the consensus parameters of this chain (default: %s)", defaults.strNetwork), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blocks=<n>", strprintf("Number of blocks in the simulated chain (default: %u)", defaults.nBlocks), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-spacing=<n>", strprintf("Seconds between simulated blocks (default: %u)", defaults.nSpacing), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-coins=<n>", strprintf("Number of wallet outputs that may stake (default: %u)", defaults.nCoins), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-value=<amt>", strprintf("Value of each wallet output (default: %s)", FormatMoney(defaults.nCoinValue)), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-minage=<n>", strprintf("Minimum age of the wallet outputs in seconds (default: %u)", defaults.nMinAge), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxage=<n>", strprintf("Maximum age of the wallet outputs in seconds (default: %u)", defaults.nMaxAge), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-bits=<hex>", strprintf("Compact stake target (default: %08x)", defaults.nBits), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-seed=<n>", strprintf("Seed for the simulated chain and wallet (default: %u)", defaults.nSeed), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-stakethreads=<n>", strprintf("Number of threads searching for a coinstake kernel (default: %d)", DEFAULT_STAKE_THREADS), false, OptionsCategory::OPTIONS);
+
+    // Hidden
+    gArgs.AddArg("-h", "", false, OptionsCategory::HIDDEN);
+    gArgs.AddArg("-help", "", false, OptionsCategory::HIDDEN);
+}
+
+/** Time every call of func and print throughput and latency percentiles. */
+static void Measure(const std::string& name, int64_t nIterations, const std::function<bool(int64_t)>& func)
+{
+    std::vector<double> vLatency;
+    vLatency.reserve(nIterations);
+    int64_t nSucceeded = 0;
+    for (int64_t i = 0; i < nIterations; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        if (func(i))
+            nSucceeded++;
+        const auto finish = std::chrono::steady_clock::now();
+        vLatency.push_back(std::chrono::duration<double, std::micro>(finish - start).count());
+    }
+    if (vLatency.empty())
+        return;
+
+    double nTotal = 0;
+    for (double nLatency : vLatency)
+        nTotal += nLatency;
+    std::sort(vLatency.begin(), vLatency.end());
+    auto percentile = [&](double p) { return vLatency[std::min<size_t>(vLatency.size() - 1, p * vLatency.size())]; };
+
+    printf("%-26s %8lld %8lld %12.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name.c_str(),
+        (long long)vLatency.size(), (long long)nSucceeded, vLatency.size() * 1e6 / nTotal,
+        vLatency.front(), percentile(0.5), percentile(0.9), percentile(0.99), vLatency.back());
+}
+
+int main(int argc, char** argv)
+{
+    benchmark::StakeSimulation::Options options;
+    SetupSimArgs(options);
+    std::string error;
+    if (!gArgs.ParseParameters(argc, argv, error)) {
+        fprintf(stderr, "Error parsing command line arguments: %s\n", error.c_str());
+        return EXIT_FAILURE;
+    }
+
+    if (HelpRequested(gArgs)) {
+        std::cout << "Usage: stakesim [options]\n\n"
+            "Time CreateCoinStake, CheckProofOfStake and ComputeNextStakeModifier against a\n"
+            "synthetic proof-of-stake chain and wallet. Latencies are in microseconds.\n\n";
+        std::cout << gArgs.GetHelpMessage();
+        return EXIT_SUCCESS;
+    }
+
+    options.strNetwork = gArgs.GetArg("-network", options.strNetwork);
+    options.nBlocks = gArgs.GetArg("-blocks", options.nBlocks);
+    options.nSpacing = gArgs.GetArg("-spacing", options.nSpacing);
+    options.nCoins = gArgs.GetArg("-coins", options.nCoins);
+    options.nMinAge = gArgs.GetArg("-minage", options.nMinAge);
+    options.nMaxAge = gArgs.GetArg("-maxage", options.nMaxAge);
+    options.nSeed = gArgs.GetArg("-seed", options.nSeed);
+    if (gArgs.IsArgSet("-value") && !ParseMoney(gArgs.GetArg("-value", ""), options.nCoinValue)) {
+        fprintf(stderr, "Error: invalid -value\n");
+        return EXIT_FAILURE;
+    }
+    if (gArgs.IsArgSet("-bits"))
+        options.nBits = strtoul(gArgs.GetArg("-bits", "").c_str(), nullptr, 16);
+    const int64_t nIterations = gArgs.GetArg("-iterations", DEFAULT_SIM_ITERATIONS);
+
+    if (options.nBlocks < 2 || options.nSpacing <= 0 || options.nCoins < 0 ||
+            options.nMinAge < 0 || options.nMinAge > options.nMaxAge || nIterations <= 0) {
+        fprintf(stderr, "Error: invalid simulation parameters\n");
+        return EXIT_FAILURE;
+    }
+    if (options.nMaxAge >= options.nBlocks * options.nSpacing)
+        fprintf(stderr, "Warning: the chain is younger than -maxage, older outputs are confirmed in block 1\n");
+
+    SHA256AutoDetect();
+    RandomInit();
+    ECC_Start();
+    SetupEnvironment();
+
+    try {
+        printf("Building %d blocks and %d wallet outputs on %s...\n", options.nBlocks, options.nCoins, options.strNetwork.c_str());
+        benchmark::StakeSimulation sim(options);
+
+        printf("%-26s %8s %8s %12s %10s %10s %10s %10s %10s\n",
+            "# operation", "calls", "ok", "ops/s", "min", "p50", "p90", "p99", "max");
+
+        std::vector<std::pair<CMutableTransaction, unsigned int>> vStakes;
+        Measure("CreateCoinStake", nIterations, [&](int64_t) {
+            CMutableTransaction txCoinStake;
+            unsigned int nTime = 0;
+            if (!sim.CreateCoinStake(txCoinStake, nTime))
+                return false;
+            vStakes.emplace_back(std::move(txCoinStake), nTime);
+            return true;
+        });
+
+        std::vector<CBlock> vBlocks;
+        for (const auto& stake : vStakes)
+            vBlocks.push_back(sim.MakeBlock(stake.first, stake.second));
+
+        if (vBlocks.empty()) {
+            printf("%-26s skipped, no coinstake found at target %08x\n", "CheckProofOfStake", options.nBits);
+        } else {
+            Measure("CheckProofOfStake", nIterations, [&](int64_t i) {
+                return sim.CheckProofOfStake(vBlocks[i % vBlocks.size()]);
+            });
+        }
+
+        // recompute the most recent modifiers in order, wrapping around like a reorg
+        const int nRange = std::min<int64_t>(nIterations, sim.Tip()->nHeight);
+        Measure("ComputeNextStakeModifier", nIterations, [&](int64_t i) {
+            return sim.ComputeStakeModifier(sim.Tip()->nHeight - nRange + 1 + i % nRange);
+        });
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        ECC_Stop();
+        return EXIT_FAILURE;
+    }
+
+    ECC_Stop();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <crypto/x16r.h>
+#include <hash.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <vector>
+
+// Hash len bytes with one X16R algorithm: 80 bytes is the first round over a
+// block header, 64 bytes every round after it
+static void HashAlgo(benchmark::State& state, int algo, size_t len)
+{
+    std::vector<unsigned char> in(len, 0);
+    unsigned char out[64];
+    while (state.KeepRunning()) {
+        X16RHashAlgo(algo, in.data(), in.size(), out);
+        in[0] ^= out[0];
+    }
+}
+
+#define X16R_ALGO_BENCHMARK(algo, name, num_iters_for_one_second)                              \
+    static void X16R_##name##_64b(benchmark::State& state) { HashAlgo(state, algo, 64); } \
+    static void X16R_##name##_80b(benchmark::State& state) { HashAlgo(state, algo, 80); } \
+    BENCHMARK(X16R_##name##_64b, num_iters_for_one_second);                                \
+    BENCHMARK(X16R_##name##_80b, num_iters_for_one_second);
+
+X16R_ALGO_BENCHMARK(0, blake, 2000 * 1000);
+X16R_ALGO_BENCHMARK(1, bmw, 1800 * 1000);
+X16R_ALGO_BENCHMARK(2, groestl, 270 * 1000);
+X16R_ALGO_BENCHMARK(3, jh, 310 * 1000);
+X16R_ALGO_BENCHMARK(4, keccak, 1000 * 1000);
+X16R_ALGO_BENCHMARK(5, skein, 2900 * 1000);
+X16R_ALGO_BENCHMARK(6, luffa, 380 * 1000);
+X16R_ALGO_BENCHMARK(7, cubehash, 140 * 1000);
+X16R_ALGO_BENCHMARK(8, shavite, 570 * 1000);
+X16R_ALGO_BENCHMARK(9, simd, 190 * 1000);
+X16R_ALGO_BENCHMARK(10, echo, 300 * 1000);
+X16R_ALGO_BENCHMARK(11, hamsi, 170 * 1000);
+X16R_ALGO_BENCHMARK(12, fugue, 240 * 1000);
+X16R_ALGO_BENCHMARK(13, shabal, 1000 * 1000);
+X16R_ALGO_BENCHMARK(14, whirlpool, 730 * 1000);
+X16R_ALGO_BENCHMARK(15, sha512, 1800 * 1000);
+
+/** Previous block hashes covering many algorithm orders, so one slow algorithm can't dominate. */
+static std::vector<uint256> PrevHashes()
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> prev(256);
+    for (uint256& hash : prev)
+        hash = rng.rand256();
+    return prev;
+}
+
+// X16R of a block header, as when checking a header or mining one nonce
+static void X16R_80b(benchmark::State& state)
+{
+    const std::vector<uint256> prev = PrevHashes();
+    unsigned char header[80] = {};
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const uint256 hash = HashX16R(header, header + sizeof(header), prev[i++ % prev.size()]);
+        header[0] ^= *hash.begin();
+    }
+}
+
+// X16R of X16R_LANES nonces of one block template at a time, as the miner does
+static void X16R_80b_Batch(benchmark::State& state)
+{
+    const std::vector<uint256> prev = PrevHashes();
+    unsigned char headers[X16R_LANES * 80] = {};
+    uint256 hashes[X16R_LANES];
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        HashX16RBatch(headers, 80, X16R_LANES, prev[i++ % prev.size()], hashes);
+        headers[0] ^= *hashes[0].begin();
+    }
+}
+
+BENCHMARK(X16R_80b, 24 * 1000);
+BENCHMARK(X16R_80b_Batch, 3 * 1000);
@@ -160,6 +160,8 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    BLOCK_POW_VALID          =  256, //!< header proof of work was verified, block reads need not hash it again
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -239,6 +241,14 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax;
 
+    //! (memory only) GetNextWorkRequired for a proof-of-work or proof-of-stake child of
+    //! this block, 0 until computed. Protected by cs_main
+    mutable unsigned int nNextWorkPoW;
+    mutable unsigned int nNextWorkPoS;
+
+    //! (memory only) X16R hash of the header, null until the header was checked. Protected by cs_main
+    uint256 hashPoW;
+
     void SetNull()
     {
         phashBlock = nullptr;
@@ -254,6 +264,9 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        nNextWorkPoW = 0;
+        nNextWorkPoS = 0;
+        hashPoW.SetNull();
 
         nMint = 0;
         nMoneySupply = 0;
@@ -29,6 +29,16 @@ namespace sha256d64_avx2
 void Transform_8way(unsigned char* out, const unsigned char* in);
 }
 
+namespace sha256d32_sse41
+{
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+
+namespace sha256d32_avx2
+{
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+
 namespace sha256d64_shani
 {
 void Transform_2way(unsigned char* out, const unsigned char* in);
@@ -416,6 +426,7 @@ void TransformD64(unsigned char* out, const unsigned char* in)
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
 typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+typedef void (*TransformD32Type)(unsigned char*, const unsigned char*);
 
 template<TransformType tr>
 void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
@@ -456,11 +467,47 @@ void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
     WriteBE32(out + 28, s[7]);
 }
 
+template<TransformType tr>
+void TransformD32Wrapper(unsigned char* out, const unsigned char* in)
+{
+    uint32_t s[8];
+    unsigned char buffer[64] = {
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0
+    };
+    memcpy(buffer, in, 32);
+    sha256::Initialize(s);
+    tr(s, buffer, 1);
+    WriteBE32(buffer + 0, s[0]);
+    WriteBE32(buffer + 4, s[1]);
+    WriteBE32(buffer + 8, s[2]);
+    WriteBE32(buffer + 12, s[3]);
+    WriteBE32(buffer + 16, s[4]);
+    WriteBE32(buffer + 20, s[5]);
+    WriteBE32(buffer + 24, s[6]);
+    WriteBE32(buffer + 28, s[7]);
+    sha256::Initialize(s);
+    tr(s, buffer, 1);
+    WriteBE32(out + 0, s[0]);
+    WriteBE32(out + 4, s[1]);
+    WriteBE32(out + 8, s[2]);
+    WriteBE32(out + 12, s[3]);
+    WriteBE32(out + 16, s[4]);
+    WriteBE32(out + 20, s[5]);
+    WriteBE32(out + 24, s[6]);
+    WriteBE32(out + 28, s[7]);
+}
+
 TransformType Transform = sha256::Transform;
 TransformD64Type TransformD64 = sha256::TransformD64;
 TransformD64Type TransformD64_2way = nullptr;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
+TransformD32Type TransformD32 = TransformD32Wrapper<sha256::Transform>;
+TransformD32Type TransformD32_4way = nullptr;
+TransformD32Type TransformD32_8way = nullptr;
 
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
@@ -508,6 +555,25 @@ bool SelfTest() {
         0x6a, 0x46, 0x30, 0xa6, 0x89, 0x86, 0x23, 0xac, 0xf8, 0xa5, 0x15, 0xe9, 0x0a, 0xaa, 0x1e, 0x9a,
         0xd7, 0x93, 0x6b, 0x28, 0xe4, 0x3b, 0xfd, 0x59, 0xc6, 0xed, 0x7c, 0x5f, 0xa5, 0x41, 0xcb, 0x51
     };
+    // Expected output for each of the individual 8 32-byte messages under full double SHA256 (including padding).
+    static const unsigned char result_d32[256] = {
+        0x9b, 0xc0, 0x22, 0x31, 0xe8, 0xc9, 0x25, 0x1b, 0x8b, 0xcb, 0x3e, 0x05, 0xac, 0x94, 0x28, 0xff,
+        0xb7, 0x07, 0x9b, 0xf2, 0x77, 0xe6, 0x8a, 0xce, 0x00, 0xd3, 0x41, 0xaf, 0x36, 0x87, 0x3a, 0x60,
+        0x61, 0xa5, 0xb2, 0xea, 0x98, 0x1c, 0x92, 0x61, 0xc2, 0x92, 0xf9, 0x0c, 0x7e, 0xe3, 0x4a, 0x74,
+        0x88, 0x90, 0x7d, 0x43, 0x6c, 0xbb, 0x00, 0x05, 0xac, 0x5f, 0xe9, 0x90, 0xd6, 0x2e, 0xb7, 0x4e,
+        0xd6, 0x9f, 0x18, 0xd8, 0x23, 0x9e, 0xa1, 0xed, 0xcd, 0xb2, 0x8f, 0xc5, 0x01, 0x64, 0xed, 0x65,
+        0xe9, 0x68, 0x76, 0x7d, 0x93, 0xf1, 0x4d, 0xf7, 0x4e, 0x1c, 0xc4, 0x1a, 0xc0, 0xbd, 0x38, 0x0c,
+        0x53, 0x28, 0x41, 0xec, 0xbc, 0xd0, 0xce, 0x4b, 0xe6, 0xa1, 0x1b, 0xea, 0xb8, 0x6b, 0x2c, 0x13,
+        0x52, 0xce, 0xbf, 0xd0, 0x52, 0xb9, 0x49, 0x91, 0x95, 0xfa, 0xcc, 0x1d, 0x34, 0x4c, 0xf9, 0x2a,
+        0x07, 0xa9, 0xf1, 0x46, 0x21, 0x8a, 0xdd, 0x19, 0x23, 0x33, 0x76, 0x05, 0xb7, 0x9c, 0x75, 0x5a,
+        0xa3, 0x8f, 0xf9, 0x5c, 0xab, 0xc4, 0x76, 0x8d, 0x7d, 0x56, 0xa2, 0x24, 0x01, 0xb7, 0x30, 0xec,
+        0x7b, 0xc5, 0x54, 0x6d, 0x20, 0x92, 0xf6, 0x69, 0x77, 0xaa, 0x6c, 0xba, 0x03, 0xea, 0x43, 0x23,
+        0x43, 0x85, 0xc3, 0x07, 0x7f, 0x5b, 0xb6, 0xf5, 0xd0, 0x55, 0x40, 0xa3, 0xf8, 0xf3, 0x96, 0x23,
+        0xc1, 0xd4, 0xcc, 0xd1, 0x34, 0xa3, 0xbb, 0x60, 0x42, 0xa6, 0xe5, 0xc1, 0xf6, 0x30, 0x4d, 0x0a,
+        0xe9, 0x23, 0x0c, 0xab, 0x35, 0xdf, 0x0e, 0x6b, 0x19, 0x38, 0xb1, 0x76, 0x52, 0x37, 0x7c, 0x26,
+        0x16, 0x91, 0x8f, 0x44, 0x78, 0x22, 0x91, 0x95, 0x3c, 0x07, 0xf4, 0xc9, 0x2e, 0x97, 0x96, 0xbc,
+        0x52, 0xdb, 0xb5, 0xec, 0x7a, 0x62, 0x6d, 0x68, 0x0a, 0x67, 0xf2, 0xd5, 0xf9, 0x4b, 0x48, 0x36
+    };
 
 
     // Test Transform() for 0 through 8 transformations.
@@ -544,6 +610,24 @@ bool SelfTest() {
         if (!std::equal(out, out + 256, result_d64)) return false;
     }
 
+    // Test TransformD32
+    TransformD32(out, data + 1);
+    if (!std::equal(out, out + 32, result_d32)) return false;
+
+    // Test TransformD32_4way, if available.
+    if (TransformD32_4way) {
+        unsigned char out[128];
+        TransformD32_4way(out, data + 1);
+        if (!std::equal(out, out + 128, result_d32)) return false;
+    }
+
+    // Test TransformD32_8way, if available.
+    if (TransformD32_8way) {
+        unsigned char out[256];
+        TransformD32_8way(out, data + 1);
+        if (!std::equal(out, out + 256, result_d32)) return false;
+    }
+
     return true;
 }
 
@@ -607,6 +691,7 @@ std::string SHA256AutoDetect()
     if (have_shani) {
         Transform = sha256_shani::Transform;
         TransformD64 = TransformD64Wrapper<sha256_shani::Transform>;
+        TransformD32 = TransformD32Wrapper<sha256_shani::Transform>;
         TransformD64_2way = sha256d64_shani::Transform_2way;
         ret = "shani(1way,2way)";
         have_sse4 = false; // Disable SSE4/AVX2;
@@ -618,10 +703,12 @@ std::string SHA256AutoDetect()
 #if defined(__x86_64__) || defined(__amd64__)
         Transform = sha256_sse4::Transform;
         TransformD64 = TransformD64Wrapper<sha256_sse4::Transform>;
+        TransformD32 = TransformD32Wrapper<sha256_sse4::Transform>;
         ret = "sse4(1way)";
 #endif
 #if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
         TransformD64_4way = sha256d64_sse41::Transform_4way;
+        TransformD32_4way = sha256d32_sse41::Transform_4way;
         ret += ",sse41(4way)";
 #endif
     }
@@ -629,6 +716,7 @@ std::string SHA256AutoDetect()
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_avx2 && have_avx && enabled_avx) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
+        TransformD32_8way = sha256d32_avx2::Transform_8way;
         ret += ",avx2(8way)";
     }
 #endif
@@ -728,3 +816,29 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+void SHA256D32(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformD32_8way) {
+        while (blocks >= 8) {
+            TransformD32_8way(out, in);
+            out += 256;
+            in += 256;
+            blocks -= 8;
+        }
+    }
+    if (TransformD32_4way) {
+        while (blocks >= 4) {
+            TransformD32_4way(out, in);
+            out += 128;
+            in += 128;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        TransformD32(out, in);
+        out += 32;
+        in += 32;
+        --blocks;
+    }
+}
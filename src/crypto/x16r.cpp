@@ -0,0 +1,279 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/x16r.h>
+
+#include <crypto/sph_blake.h>
+#include <crypto/sph_bmw.h>
+#include <crypto/sph_cubehash.h>
+#include <crypto/sph_echo.h>
+#include <crypto/sph_fugue.h>
+#include <crypto/sph_groestl.h>
+#include <crypto/sph_hamsi.h>
+#include <crypto/sph_jh.h>
+#include <crypto/sph_keccak.h>
+#include <crypto/sph_luffa.h>
+#include <crypto/sph_sha2.h>
+#include <crypto/sph_shabal.h>
+#include <crypto/sph_shavite.h>
+#include <crypto/sph_simd.h>
+#include <crypto/sph_skein.h>
+#include <crypto/sph_whirlpool.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace x16r_avx2
+{
+void Keccak512_64_4way(unsigned char* out, const unsigned char* in);
+void Sha512_64_4way(unsigned char* out, const unsigned char* in);
+}
+#endif
+
+namespace {
+
+/** Hashes four 64 byte inputs laid out back to back. */
+typedef void (*Hash64_4wayFn)(unsigned char* out, const unsigned char* in);
+
+Hash64_4wayFn Hash64_4way[X16R_ALGOS] = {};
+
+/** Hashes len bytes of input, using ctx as the algorithm's context. */
+typedef void (*HashFn)(void* ctx, const void* input, size_t len, unsigned char* output);
+
+template<void (*Init)(void*), void (*Update)(void*, const void*, size_t), void (*Close)(void*, void*)>
+void Hash(void* ctx, const void* input, size_t len, unsigned char* output)
+{
+    Init(ctx);
+    Update(ctx, input, len);
+    Close(ctx, output);
+}
+
+const HashFn HASH[X16R_ALGOS] = {
+    Hash<sph_blake512_init, sph_blake512, sph_blake512_close>,
+    Hash<sph_bmw512_init, sph_bmw512, sph_bmw512_close>,
+    Hash<sph_groestl512_init, sph_groestl512, sph_groestl512_close>,
+    Hash<sph_jh512_init, sph_jh512, sph_jh512_close>,
+    Hash<sph_keccak512_init, sph_keccak512, sph_keccak512_close>,
+    Hash<sph_skein512_init, sph_skein512, sph_skein512_close>,
+    Hash<sph_luffa512_init, sph_luffa512, sph_luffa512_close>,
+    Hash<sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close>,
+    Hash<sph_shavite512_init, sph_shavite512, sph_shavite512_close>,
+    Hash<sph_simd512_init, sph_simd512, sph_simd512_close>,
+    Hash<sph_echo512_init, sph_echo512, sph_echo512_close>,
+    Hash<sph_hamsi512_init, sph_hamsi512, sph_hamsi512_close>,
+    Hash<sph_fugue512_init, sph_fugue512, sph_fugue512_close>,
+    Hash<sph_shabal512_init, sph_shabal512, sph_shabal512_close>,
+    Hash<sph_whirlpool_init, sph_whirlpool, sph_whirlpool_close>,
+    Hash<sph_sha512_init, sph_sha512, sph_sha512_close>,
+};
+
+/** Large enough for the context of any X16R algorithm. */
+union Context {
+    sph_blake512_context blake;
+    sph_bmw512_context bmw;
+    sph_groestl512_context groestl;
+    sph_jh512_context jh;
+    sph_keccak512_context keccak;
+    sph_skein512_context skein;
+    sph_luffa512_context luffa;
+    sph_cubehash512_context cubehash;
+    sph_shavite512_context shavite;
+    sph_simd512_context simd;
+    sph_echo512_context echo;
+    sph_hamsi512_context hamsi;
+    sph_fugue512_context fugue;
+    sph_shabal512_context shabal;
+    sph_whirlpool_context whirlpool;
+    sph_sha512_context sha512;
+};
+
+const unsigned char BLANK[1] = {};
+
+const char* const ALGO_NAMES[X16R_ALGOS] = {
+    "blake", "bmw", "groestl", "jh", "keccak", "skein", "luffa", "cubehash",
+    "shavite", "simd", "echo", "hamsi", "fugue", "shabal", "whirlpool", "sha512",
+};
+
+std::atomic<bool> g_stats_enabled{false};
+std::atomic<uint64_t> g_stats_hashes[X16R_ALGOS];
+std::atomic<uint64_t> g_stats_nanos[X16R_ALGOS];
+
+int64_t inline NowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void inline RecordStats(int algo, size_t lanes, int64_t start)
+{
+    g_stats_hashes[algo].fetch_add(lanes, std::memory_order_relaxed);
+    g_stats_nanos[algo].fetch_add(NowNanos() - start, std::memory_order_relaxed);
+}
+
+bool SelfTest()
+{
+    // Every multi-lane implementation must match the scalar one, including
+    // lanes that differ from each other
+    unsigned char in[4 * 64], out[4 * 64], expected[64];
+    for (size_t i = 0; i < sizeof(in); ++i) in[i] = (unsigned char)(i * 7 + 1);
+    for (int algo = 0; algo < X16R_ALGOS; ++algo) {
+        if (!Hash64_4way[algo]) continue;
+        Hash64_4way[algo](out, in);
+        for (int lane = 0; lane < 4; ++lane) {
+            X16RHashAlgo(algo, in + 64 * lane, 64, expected);
+            if (memcmp(out + 64 * lane, expected, 64)) return false;
+        }
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+const char* X16RAlgoName(int algo)
+{
+    assert(algo >= 0 && algo < X16R_ALGOS);
+    return ALGO_NAMES[algo];
+}
+
+void X16RHashAlgo(int algo, const void* input, size_t len, unsigned char* output)
+{
+    assert(algo >= 0 && algo < X16R_ALGOS);
+    Context ctx;
+    HASH[algo](&ctx, len ? input : BLANK, len, output);
+}
+
+void X16RHash64(int algo, unsigned char* output, const unsigned char* input, size_t count)
+{
+    size_t i = 0;
+    if (Hash64_4way[algo]) {
+        for (; i + 4 <= count; i += 4) Hash64_4way[algo](output + 64 * i, input + 64 * i);
+    }
+    for (; i < count; ++i) X16RHashAlgo(algo, input + 64 * i, 64, output + 64 * i);
+}
+
+void X16RHashChain(const int order[X16R_ALGOS], const unsigned char* input, size_t len, size_t count, unsigned char* output)
+{
+    X16RPlan(order).Hash(input, len, count, output);
+}
+
+X16RPlan::X16RPlan(const int orderIn[X16R_ALGOS])
+{
+    static_assert(sizeof(ctx) >= sizeof(Context), "X16RPlan::ctx can't hold every context");
+    for (int round = 0; round < X16R_ALGOS; ++round) {
+        assert(orderIn[round] >= 0 && orderIn[round] < X16R_ALGOS);
+        order[round] = orderIn[round];
+        hash[round] = HASH[order[round]];
+        hash64_4way[round] = Hash64_4way[order[round]];
+    }
+}
+
+void X16RPlan::Hash(const unsigned char* input, size_t len, size_t count, unsigned char* output)
+{
+    const bool fStats = g_stats_enabled.load(std::memory_order_relaxed);
+    while (count) {
+        const size_t lanes = std::min(count, X16R_LANES);
+        int64_t start = fStats ? NowNanos() : 0;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            hash[0](ctx, len ? input + len * lane : BLANK, len, buf[0] + 64 * lane);
+        }
+        if (fStats) RecordStats(order[0], lanes, start);
+        for (int round = 1; round < X16R_ALGOS; ++round) {
+            if (fStats) start = NowNanos();
+            const unsigned char* in = buf[(round - 1) & 1];
+            unsigned char* out = buf[round & 1];
+            size_t lane = 0;
+            if (hash64_4way[round]) {
+                for (; lane + 4 <= lanes; lane += 4) hash64_4way[round](out + 64 * lane, in + 64 * lane);
+            }
+            for (; lane < lanes; ++lane) hash[round](ctx, in + 64 * lane, 64, out + 64 * lane);
+            if (fStats) RecordStats(order[round], lanes, start);
+        }
+        // the result is the first half of the last round
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            memcpy(output + 32 * lane, buf[(X16R_ALGOS - 1) & 1] + 64 * lane, 32);
+        }
+        input += len * lanes;
+        output += 32 * lanes;
+        count -= lanes;
+    }
+}
+
+std::string X16RAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_avx2;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && enabled_avx) {
+        Hash64_4way[4] = x16r_avx2::Keccak512_64_4way;
+        Hash64_4way[15] = x16r_avx2::Sha512_64_4way;
+        ret = "avx2(keccak512,sha512 4way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void X16RSetStatsEnabled(bool enabled)
+{
+    g_stats_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool X16RStatsEnabled()
+{
+    return g_stats_enabled.load(std::memory_order_relaxed);
+}
+
+void X16RGetStats(uint64_t hashes[X16R_ALGOS], uint64_t nanos[X16R_ALGOS])
+{
+    for (int algo = 0; algo < X16R_ALGOS; ++algo) {
+        hashes[algo] = g_stats_hashes[algo].load(std::memory_order_relaxed);
+        nanos[algo] = g_stats_nanos[algo].load(std::memory_order_relaxed);
+    }
+}
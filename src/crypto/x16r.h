@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_X16R_H
+#define BITCOIN_CRYPTO_X16R_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Number of X16R algorithms, and rounds of the X16R chain. */
+static const int X16R_ALGOS = 16;
+/** Number of inputs X16RHashChain keeps in flight through the rounds. */
+static const size_t X16R_LANES = 8;
+
+/** Name of X16R algorithm algo, e.g. "blake". */
+const char* X16RAlgoName(int algo);
+
+/** Hash len bytes of input with X16R algorithm algo (0 = blake, ..., 15 = sha512), writing 64 bytes. */
+void X16RHashAlgo(int algo, const void* input, size_t len, unsigned char* output);
+
+/**
+ * Hash count 64 byte inputs laid out back to back with algorithm algo,
+ * using SIMD lanes for the algorithms that have them.
+ */
+void X16RHash64(int algo, unsigned char* output, const unsigned char* input, size_t count);
+
+/**
+ * Compute the X16R chain of count inputs of len bytes each, laid out back to
+ * back, that share the algorithm order (the same previous block hash). Each
+ * round runs over X16R_LANES inputs at a time, so the lanes of one algorithm
+ * are hashed together. Writes 32 bytes per input.
+ */
+void X16RHashChain(const int order[X16R_ALGOS], const unsigned char* input, size_t len, size_t count, unsigned char* output);
+
+/**
+ * The X16R chain for one algorithm order, with the implementation of every
+ * round resolved up front. Build it once per previous block hash and reuse it
+ * for all the inputs that share it, e.g. the nonces of a block template.
+ * Hashing uses scratch space held by the plan, so a plan must not be shared
+ * between threads. Build plans after X16RAutoDetect.
+ */
+class X16RPlan
+{
+public:
+    explicit X16RPlan(const int order[X16R_ALGOS]);
+
+    /** X16RHashChain with the order of this plan. */
+    void Hash(const unsigned char* input, size_t len, size_t count, unsigned char* output);
+
+private:
+    typedef void (*HashFn)(void* ctx, const void* input, size_t len, unsigned char* output);
+    typedef void (*Hash64_4wayFn)(unsigned char* output, const unsigned char* input);
+
+    int order[X16R_ALGOS];
+    HashFn hash[X16R_ALGOS];
+    Hash64_4wayFn hash64_4way[X16R_ALGOS];
+
+    //! Fits the context of any of the algorithms
+    alignas(64) unsigned char ctx[384];
+    alignas(64) unsigned char buf[2][X16R_LANES * 64];
+};
+
+/** Autodetect the best available multi-lane X16R implementations. Returns their names. */
+std::string X16RAutoDetect();
+
+/**
+ * Start or stop counting the inputs hashed and the time spent by each algorithm
+ * in X16RHashChain. Off by default, the counters are shared by all threads.
+ */
+void X16RSetStatsEnabled(bool enabled);
+bool X16RStatsEnabled();
+
+/** Inputs hashed and nanoseconds spent by each algorithm while counting was enabled. */
+void X16RGetStats(uint64_t hashes[X16R_ALGOS], uint64_t nanos[X16R_ALGOS]);
+
+#endif // BITCOIN_CRYPTO_X16R_H
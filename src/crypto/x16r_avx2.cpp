@@ -0,0 +1,208 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// 4-way X16R algorithms over 64 byte inputs, the shape of rounds 1 to 15 of
+// the X16R chain. Each 256 bit register holds the same 64 bit word of four
+// independent messages.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace x16r_avx2 {
+namespace {
+
+__m256i inline K(uint64_t x) { return _mm256_set1_epi64x(x); }
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z) { return Add(Add(x, y), z); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z, __m256i w) { return Add(Add(x, y), Add(z, w)); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Xor(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline Xor(__m256i x, __m256i y, __m256i z, __m256i w, __m256i v) { return Xor(Xor(x, y, z), Xor(w, v)); }
+__m256i inline Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+/** ~x & y */
+__m256i inline AndNot(__m256i x, __m256i y) { return _mm256_andnot_si256(x, y); }
+__m256i inline ShR(__m256i x, int n) { return _mm256_srli_epi64(x, n); }
+__m256i inline ShL(__m256i x, int n) { return _mm256_slli_epi64(x, n); }
+__m256i inline RotR(__m256i x, int n) { return Or(ShR(x, n), ShL(x, 64 - n)); }
+__m256i inline RotL(__m256i x, int n) { return Or(ShL(x, n), ShR(x, 64 - n)); }
+
+/** Word i of the four 64 byte messages at in. */
+__m256i inline ReadLE(const unsigned char* in, int i)
+{
+    return _mm256_set_epi64x(ReadLE64(in + 192 + 8 * i), ReadLE64(in + 128 + 8 * i), ReadLE64(in + 64 + 8 * i), ReadLE64(in + 8 * i));
+}
+
+__m256i inline ReadBE(const unsigned char* in, int i)
+{
+    return _mm256_set_epi64x(ReadBE64(in + 192 + 8 * i), ReadBE64(in + 128 + 8 * i), ReadBE64(in + 64 + 8 * i), ReadBE64(in + 8 * i));
+}
+
+void inline WriteLE(unsigned char* out, int i, __m256i v)
+{
+    alignas(32) uint64_t tmp[4];
+    _mm256_store_si256((__m256i*)tmp, v);
+    WriteLE64(out + 8 * i, tmp[0]);
+    WriteLE64(out + 64 + 8 * i, tmp[1]);
+    WriteLE64(out + 128 + 8 * i, tmp[2]);
+    WriteLE64(out + 192 + 8 * i, tmp[3]);
+}
+
+void inline WriteBE(unsigned char* out, int i, __m256i v)
+{
+    alignas(32) uint64_t tmp[4];
+    _mm256_store_si256((__m256i*)tmp, v);
+    WriteBE64(out + 8 * i, tmp[0]);
+    WriteBE64(out + 64 + 8 * i, tmp[1]);
+    WriteBE64(out + 128 + 8 * i, tmp[2]);
+    WriteBE64(out + 192 + 8 * i, tmp[3]);
+}
+
+const uint64_t KECCAK_RC[24] = {
+    0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808aull, 0x8000000080008000ull,
+    0x000000000000808bull, 0x0000000080000001ull, 0x8000000080008081ull, 0x8000000000008009ull,
+    0x000000000000008aull, 0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000aull,
+    0x000000008000808bull, 0x800000000000008bull, 0x8000000000008089ull, 0x8000000000008003ull,
+    0x8000000000008002ull, 0x8000000000000080ull, 0x000000000000800aull, 0x800000008000000aull,
+    0x8000000080008081ull, 0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull,
+};
+
+/** Lane x + 5 * y of the state after rho and pi, with its rotation in rho. */
+#define KECCAK_B(x, y, r) b[(y) + 5 * ((2 * (x) + 3 * (y)) % 5)] = RotL(Xor(a[(x) + 5 * (y)], d[x]), r)
+#define KECCAK_CHI(y) \
+    a[5 * (y) + 0] = Xor(b[5 * (y) + 0], AndNot(b[5 * (y) + 1], b[5 * (y) + 2])); \
+    a[5 * (y) + 1] = Xor(b[5 * (y) + 1], AndNot(b[5 * (y) + 2], b[5 * (y) + 3])); \
+    a[5 * (y) + 2] = Xor(b[5 * (y) + 2], AndNot(b[5 * (y) + 3], b[5 * (y) + 4])); \
+    a[5 * (y) + 3] = Xor(b[5 * (y) + 3], AndNot(b[5 * (y) + 4], b[5 * (y) + 0])); \
+    a[5 * (y) + 4] = Xor(b[5 * (y) + 4], AndNot(b[5 * (y) + 0], b[5 * (y) + 1]))
+
+/** Keccak-f[1600] */
+void inline KeccakF(__m256i a[25])
+{
+    __m256i b[25], c[5], d[5];
+    for (int round = 0; round < 24; ++round) {
+        // theta
+        c[0] = Xor(a[0], a[5], a[10], a[15], a[20]);
+        c[1] = Xor(a[1], a[6], a[11], a[16], a[21]);
+        c[2] = Xor(a[2], a[7], a[12], a[17], a[22]);
+        c[3] = Xor(a[3], a[8], a[13], a[18], a[23]);
+        c[4] = Xor(a[4], a[9], a[14], a[19], a[24]);
+        d[0] = Xor(c[4], RotL(c[1], 1));
+        d[1] = Xor(c[0], RotL(c[2], 1));
+        d[2] = Xor(c[1], RotL(c[3], 1));
+        d[3] = Xor(c[2], RotL(c[4], 1));
+        d[4] = Xor(c[3], RotL(c[0], 1));
+        // rho and pi
+        b[0] = Xor(a[0], d[0]);
+        KECCAK_B(1, 0, 1); KECCAK_B(2, 0, 62); KECCAK_B(3, 0, 28); KECCAK_B(4, 0, 27);
+        KECCAK_B(0, 1, 36); KECCAK_B(1, 1, 44); KECCAK_B(2, 1, 6); KECCAK_B(3, 1, 55); KECCAK_B(4, 1, 20);
+        KECCAK_B(0, 2, 3); KECCAK_B(1, 2, 10); KECCAK_B(2, 2, 43); KECCAK_B(3, 2, 25); KECCAK_B(4, 2, 39);
+        KECCAK_B(0, 3, 41); KECCAK_B(1, 3, 45); KECCAK_B(2, 3, 15); KECCAK_B(3, 3, 21); KECCAK_B(4, 3, 8);
+        KECCAK_B(0, 4, 18); KECCAK_B(1, 4, 2); KECCAK_B(2, 4, 61); KECCAK_B(3, 4, 56); KECCAK_B(4, 4, 14);
+        // chi
+        KECCAK_CHI(0); KECCAK_CHI(1); KECCAK_CHI(2); KECCAK_CHI(3); KECCAK_CHI(4);
+        // iota
+        a[0] = Xor(a[0], K(KECCAK_RC[round]));
+    }
+}
+
+#undef KECCAK_B
+#undef KECCAK_CHI
+
+const uint64_t SHA512_K[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull,
+};
+
+const uint64_t SHA512_INIT[8] = {
+    0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+    0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull,
+};
+
+__m256i inline Ch(__m256i x, __m256i y, __m256i z) { return Xor(z, And(x, Xor(y, z))); }
+__m256i inline Maj(__m256i x, __m256i y, __m256i z) { return Or(And(x, y), And(z, Or(x, y))); }
+__m256i inline Sigma0(__m256i x) { return Xor(RotR(x, 28), RotR(x, 34), RotR(x, 39)); }
+__m256i inline Sigma1(__m256i x) { return Xor(RotR(x, 14), RotR(x, 18), RotR(x, 41)); }
+__m256i inline sigma0(__m256i x) { return Xor(RotR(x, 1), RotR(x, 8), ShR(x, 7)); }
+__m256i inline sigma1(__m256i x) { return Xor(RotR(x, 19), RotR(x, 61), ShR(x, 6)); }
+
+} // namespace
+
+/** Keccak-512 (the original padding, as sph_keccak512) of four 64 byte messages. */
+void Keccak512_64_4way(unsigned char* out, const unsigned char* in)
+{
+    // the message and its padding fit the 72 byte rate
+    __m256i a[25];
+    for (int i = 0; i < 8; ++i) a[i] = ReadLE(in, i);
+    a[8] = K(0x8000000000000001ull);
+    for (int i = 9; i < 25; ++i) a[i] = _mm256_setzero_si256();
+
+    KeccakF(a);
+
+    for (int i = 0; i < 8; ++i) WriteLE(out, i, a[i]);
+}
+
+/** SHA-512 of four 64 byte messages. */
+void Sha512_64_4way(unsigned char* out, const unsigned char* in)
+{
+    // the message and its padding fit one 128 byte block
+    __m256i w[80];
+    for (int i = 0; i < 8; ++i) w[i] = ReadBE(in, i);
+    w[8] = K(0x8000000000000000ull);
+    for (int i = 9; i < 15; ++i) w[i] = _mm256_setzero_si256();
+    w[15] = K(512);
+    for (int i = 16; i < 80; ++i) w[i] = Add(sigma1(w[i - 2]), w[i - 7], sigma0(w[i - 15]), w[i - 16]);
+
+    __m256i s[8];
+    for (int i = 0; i < 8; ++i) s[i] = K(SHA512_INIT[i]);
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 80; ++i) {
+        const __m256i t1 = Add(Add(h, Sigma1(e)), Ch(e, f, g), K(SHA512_K[i]), w[i]);
+        const __m256i t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = Add(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = Add(t1, t2);
+    }
+
+    WriteBE(out, 0, Add(s[0], a));
+    WriteBE(out, 1, Add(s[1], b));
+    WriteBE(out, 2, Add(s[2], c));
+    WriteBE(out, 3, Add(s[3], d));
+    WriteBE(out, 4, Add(s[4], e));
+    WriteBE(out, 5, Add(s[5], f));
+    WriteBE(out, 6, Add(s[6], g));
+    WriteBE(out, 7, Add(s[7], h));
+}
+
+} // namespace x16r_avx2
+
+#endif
@@ -58,6 +58,8 @@ void CDSNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock
     {
         instantsend.SyncTransaction(tx, nullptr);
     }
+
+    mnodeman.UpdateCollaterals(*block);
 }
 
 void CDSNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock> &block)
@@ -66,4 +68,6 @@ void CDSNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBl
     {
         instantsend.SyncTransaction(tx, nullptr);
     }
+
+    mnodeman.UpdateCollaterals(*block);
 }
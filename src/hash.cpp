@@ -245,3 +245,17 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+void HashX16RBatch(const unsigned char* input, size_t len, size_t count, const uint256& PrevBlockHash, uint256* output)
+{
+    int order[X16R_ALGOS];
+    GetHashSelections(PrevBlockHash, order);
+    X16RPlan plan(order);
+    HashX16RBatch(plan, input, len, count, output);
+}
+
+void HashX16RBatch(X16RPlan& plan, const unsigned char* input, size_t len, size_t count, uint256* output)
+{
+    static_assert(sizeof(uint256) == 32, "uint256 outputs must be contiguous");
+    plan.Hash(input, len, count, output->begin());
+}
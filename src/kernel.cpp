@@ -6,6 +6,8 @@
 #include <boost/lexical_cast.hpp>
 
 #include <chainparams.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
 #include <db.h>
 #include <kernel.h>
 #include <script/interpreter.h>
@@ -17,6 +19,7 @@
 #include <init.h>
 #include <utiltime.h>
 
+#include <algorithm>
 #include <numeric>
 
 #define PRI64x  "llx"
@@ -34,6 +37,9 @@ unsigned int getIntervalVersion(bool fTestNet)
         return MODIFIER_INTERVAL;
 }
 
+CStakeModifierIndex stakeModifierIndex;
+CStakeModifierCandidates stakeModifierCandidates;
+
 // Hard checkpoints of stake modifiers to ensure they are deterministic
 static std::map<int, unsigned int> mapStakeModifierCheckpoints =
         boost::assign::map_list_of(0, 0xfd11f4e7);
@@ -77,53 +83,115 @@ static int64_t GetStakeModifierSelectionInterval()
     return nSelectionInterval;
 }
 
-// select a block from the candidate blocks in vSortedByTimestamp, excluding
-// already selected blocks in vSelectedBlocks, and with timestamp up to
-// nSelectionIntervalStop.
-static bool SelectBlockFromCandidates(
-        vector<pair<int64_t, uint256> >& vSortedByTimestamp,
-        map<uint256, const CBlockIndex*>& mapSelectedBlocks,
-        int64_t nSelectionIntervalStop, uint64_t nStakeModifierPrev,
-        const CBlockIndex** pindexSelected)
+void CStakeModifierCandidates::MoveWindow(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart)
 {
-    bool fSelected = false;
-    arith_uint256 hashBest;
-    *pindexSelected = nullptr;
-    for(const auto &item : vSortedByTimestamp)
-    {
-        if (!mapBlockIndex.count(item.second))
-            return error("SelectBlockFromCandidates: failed to find block index for candidate block %s", item.second.ToString().c_str());
-        const CBlockIndex* pindex = mapBlockIndex[item.second];
-        if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
-            break;
-        if (mapSelectedBlocks.count(pindex->GetBlockHash()) > 0)
-            continue;
-        // compute the selection hash by hashing its proof-hash and the
-        // previous proof-of-stake modifier
-        uint256 hashProof = pindex->IsProofOfStake()? pindex->hashProofOfStake : pindex->GetBlockHash();
-        CDataStream ss(SER_GETHASH, 0);
-        ss << hashProof << nStakeModifierPrev;
-        arith_uint256 hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
-        // the selection hash is divided by 2**32 so that proof-of-stake block
-        // is always favored over proof-of-work block. this is to preserve
-        // the energy efficiency property
-        if (pindex->IsProofOfStake())
-            hashSelection >>= 32;
-        if (fSelected && hashSelection < hashBest)
-        {
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*) pindex;
+    // drop candidates that are not below pindexPrev (a different branch, or above it)
+    while (!vWindow.empty() && pindexPrev->GetAncestor(vWindow.back().pindex->nHeight) != vWindow.back().pindex)
+        vWindow.pop_back();
+
+    // add the blocks connected on top of what is left
+    if (!vWindow.empty()) {
+        std::vector<const CBlockIndex*> vNew;
+        for (const CBlockIndex* pindex = pindexPrev; pindex != vWindow.back().pindex; pindex = pindex->pprev)
+            vNew.push_back(pindex);
+        for (auto it = vNew.rbegin(); it != vNew.rend(); ++it)
+            vWindow.emplace_back(*it);
+    } else {
+        vWindow.emplace_back(pindexPrev);
+    }
+
+    // the window starts above the highest block older than the interval start
+    for (size_t i = vWindow.size(); i-- > 0;) {
+        if (vWindow[i].pindex->GetBlockTime() < nSelectionIntervalStart) {
+            vWindow.erase(vWindow.begin(), vWindow.begin() + i + 1);
+            return;
+        }
+    }
+    // or further down than it used to
+    const CBlockIndex* pindex = vWindow.front().pindex->pprev;
+    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
+        vWindow.emplace_front(pindex);
+        pindex = pindex->pprev;
+    }
+}
+
+bool CStakeModifierCandidates::SelectBlocks(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart, uint64_t nStakeModifierPrev,
+                                            std::vector<const CBlockIndex*>& vSelected, int& nHeightFirstCandidate)
+{
+    LOCK(cs);
+    MoveWindow(pindexPrev, nSelectionIntervalStart);
+    nHeightFirstCandidate = vWindow.empty() ? pindexPrev->nHeight + 1 : vWindow.front().pindex->nHeight;
+
+    // Sort candidate blocks by timestamp
+    std::vector<Candidate*> vSortedByTimestamp;
+    vSortedByTimestamp.reserve(vWindow.size());
+    for (Candidate& candidate : vWindow) {
+        if (!candidate.fHashed || candidate.nModifierPrev != nStakeModifierPrev) {
+            // compute the selection hash by hashing its proof-hash and the
+            // previous proof-of-stake modifier
+            const CBlockIndex* pindex = candidate.pindex;
+            uint256 hashProof = pindex->IsProofOfStake()? pindex->hashProofOfStake : pindex->GetBlockHash();
+            CDataStream ss(SER_GETHASH, 0);
+            ss << hashProof << nStakeModifierPrev;
+            candidate.hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
+            // the selection hash is divided by 2**32 so that proof-of-stake block
+            // is always favored over proof-of-work block. this is to preserve
+            // the energy efficiency property
+            if (pindex->IsProofOfStake())
+                candidate.hashSelection >>= 32;
+            candidate.nModifierPrev = nStakeModifierPrev;
+            candidate.fHashed = true;
         }
-        else if (!fSelected)
+        vSortedByTimestamp.push_back(&candidate);
+    }
+    std::sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end(), [](const Candidate* a, const Candidate* b) {
+        if (a->pindex->GetBlockTime() != b->pindex->GetBlockTime())
+            return a->pindex->GetBlockTime() < b->pindex->GetBlockTime();
+        return a->pindex->GetBlockHash() < b->pindex->GetBlockHash();
+    });
+
+    // Select 64 blocks from candidate blocks to generate stake modifier
+    std::vector<bool> vfSelected(vSortedByTimestamp.size(), false);
+    int64_t nSelectionIntervalStop = nSelectionIntervalStart;
+    vSelected.clear();
+    for (int nRound = 0; nRound < std::min(64, (int)vSortedByTimestamp.size()); nRound++)
+    {
+        // add an interval section to the current selection round
+        nSelectionIntervalStop += GetStakeModifierSelectionIntervalSection(nRound);
+
+        // select a block from the candidates of current round, excluding
+        // already selected blocks, and with timestamp up to nSelectionIntervalStop
+        bool fSelected = false;
+        size_t nBest = 0;
+        for (size_t i = 0; i < vSortedByTimestamp.size(); i++)
         {
-            fSelected = true;
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*) pindex;
+            const Candidate* candidate = vSortedByTimestamp[i];
+            if (fSelected && candidate->pindex->GetBlockTime() > nSelectionIntervalStop)
+                break;
+            if (vfSelected[i])
+                continue;
+            if (!fSelected || candidate->hashSelection < vSortedByTimestamp[nBest]->hashSelection)
+            {
+                fSelected = true;
+                nBest = i;
+            }
         }
+        if (!fSelected)
+            return error("%s: unable to select block at round %d", __func__, nRound);
+        if (gArgs.GetBoolArg("-printstakemodifier", false))
+            LogPrint(BCLog::KERNEL, "%s : selection hash=%s\n", __func__, vSortedByTimestamp[nBest]->hashSelection.ToString().c_str());
+
+        vfSelected[nBest] = true;
+        vSelected.push_back(vSortedByTimestamp[nBest]->pindex);
+        LogPrint(BCLog::KERNEL, "%s : selected round %d stop=%s height=%d bit=%d\n", __func__, nRound, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nSelectionIntervalStop).c_str(), vSelected.back()->nHeight, vSelected.back()->GetStakeEntropyBit());
     }
-    if (gArgs.GetBoolArg("-printstakemodifier", false))
-        LogPrint(BCLog::KERNEL, "%s : selection hash=%s\n", __func__, hashBest.ToString().c_str());
-    return fSelected;
+    return true;
+}
+
+void CStakeModifierCandidates::Clear()
+{
+    LOCK(cs);
+    vWindow.clear();
 }
 
 // Stake Modifier (hash modifier of proof-of-stake):
@@ -159,38 +227,17 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexCurrent, uint64_t &nStake
     if (nModifierTime / params.nModifierInterval >= pindexPrev->GetBlockTime() / params.nModifierInterval)
         return true;
 
-    // Sort candidate blocks by timestamp
-    vector<pair<int64_t, uint256> > vSortedByTimestamp;
-    vSortedByTimestamp.reserve(64 * params.nModifierInterval / params.nPosTargetSpacing);
     int64_t nSelectionInterval = GetStakeModifierSelectionInterval();
     int64_t nSelectionIntervalStart = (pindexPrev->GetBlockTime() / params.nModifierInterval) * params.nModifierInterval - nSelectionInterval;
-    const CBlockIndex* pindex = pindexPrev;
-    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart)
-    {
-        vSortedByTimestamp.push_back(make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
-        pindex = pindex->pprev;
-    }
-    int nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
-    reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
-    sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+    std::vector<const CBlockIndex*> vSelected;
+    int nHeightFirstCandidate = 0;
+    if (!stakeModifierCandidates.SelectBlocks(pindexPrev, nSelectionIntervalStart, nStakeModifier, vSelected, nHeightFirstCandidate))
+        return error("ComputeNextStakeModifier: unable to select blocks");
 
-    // Select 64 blocks from candidate blocks to generate stake modifier
+    // write the entropy bits of the selected blocks
     uint64_t nStakeModifierNew = 0;
-    int64_t nSelectionIntervalStop = nSelectionIntervalStart;
-    map<uint256, const CBlockIndex*> mapSelectedBlocks;
-    for (int nRound=0; nRound<min(64, (int)vSortedByTimestamp.size()); nRound++)
-    {
-        // add an interval section to the current selection round
-        nSelectionIntervalStop += GetStakeModifierSelectionIntervalSection(nRound);
-        // select a block from the candidates of current round
-        if (!SelectBlockFromCandidates(vSortedByTimestamp, mapSelectedBlocks, nSelectionIntervalStop, nStakeModifier, &pindex))
-            return error("ComputeNextStakeModifier: unable to select block at round %d", nRound);
-        // write the entropy bit of the selected block
-        nStakeModifierNew |= (((uint64_t)pindex->GetStakeEntropyBit()) << nRound);
-        // add the selected block from candidates to selected list
-        mapSelectedBlocks.insert(make_pair(pindex->GetBlockHash(), pindex));
-        LogPrint(BCLog::KERNEL, "%s : selected round %d stop=%s height=%d bit=%d\n", __func__, nRound, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nSelectionIntervalStop).c_str(), pindex->nHeight, pindex->GetStakeEntropyBit());
-    }
+    for (size_t nRound = 0; nRound < vSelected.size(); nRound++)
+        nStakeModifierNew |= (((uint64_t)vSelected[nRound]->GetStakeEntropyBit()) << nRound);
 
     // Print selection map for visualization of the selected blocks
     if (gArgs.GetBoolArg("-debug", false) && gArgs.GetBoolArg("-printstakemodifier", false))
@@ -198,7 +245,7 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexCurrent, uint64_t &nStake
         string strSelectionMap = "";
         // '-' indicates proof-of-work blocks not selected
         strSelectionMap.insert(0, pindexPrev->nHeight - nHeightFirstCandidate + 1, '-');
-        pindex = pindexPrev;
+        const CBlockIndex* pindex = pindexPrev;
         while (pindex && pindex->nHeight >= nHeightFirstCandidate)
         {
             // '=' indicates proof-of-stake blocks not selected
@@ -206,11 +253,11 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexCurrent, uint64_t &nStake
                 strSelectionMap.replace(pindex->nHeight - nHeightFirstCandidate, 1, "=");
             pindex = pindex->pprev;
         }
-        for (const auto& item : mapSelectedBlocks)
+        for (const CBlockIndex* pindexSelected : vSelected)
         {
             // 'S' indicates selected proof-of-stake blocks
             // 'W' indicates selected proof-of-work blocks
-            strSelectionMap.replace(item.second->nHeight - nHeightFirstCandidate, 1, item.second->IsProofOfStake()? "S" : "W");
+            strSelectionMap.replace(pindexSelected->nHeight - nHeightFirstCandidate, 1, pindexSelected->IsProofOfStake()? "S" : "W");
         }
         LogPrintf("ComputeNextStakeModifier: selection height [%d, %d] map %s\n", nHeightFirstCandidate, pindexPrev->nHeight, strSelectionMap);
     }
@@ -221,41 +268,226 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexCurrent, uint64_t &nStake
     return true;
 }
 
-static bool GetKernelStakeModifierV03(uint256 hashBlockFrom, unsigned int nTimeTx, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
+void CStakeModifierIndex::Sync(const CChain& chain)
 {
-    nStakeModifier = 0;
-    if (!mapBlockIndex.count(hashBlockFrom))
-        return error("GetKernelStakeModifier() : block not indexed");
-
-    const CBlockIndex* pindexFrom = mapBlockIndex[hashBlockFrom];
-    nStakeModifierHeight = pindexFrom->nHeight;
-    nStakeModifierTime = pindexFrom->GetBlockTime();
-    int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
-    const CBlockIndex* pindex = pindexFrom;
-    CBlockIndex* pindexNext = chainActive[pindexFrom->nHeight + 1];
-
-    // loop to find the stake modifier later by a selection interval
-    while (nStakeModifierTime < pindexFrom->GetBlockTime() + nStakeModifierSelectionInterval)
-    {
-        if (!pindexNext) {
-            return false;
+    LOCK(cs);
+    if (pindexBest == chain.Tip())
+        return;
+
+    // drop the entries of blocks disconnected since the last sync
+    const CBlockIndex* pindexFork = pindexBest ? chain.FindFork(pindexBest) : nullptr;
+    const int nForkHeight = pindexFork ? pindexFork->nHeight : -1;
+    while (!vGenerated.empty() && vGenerated.back()->nHeight > nForkHeight)
+        vGenerated.pop_back();
+
+    // and record the ones that were connected on top of the fork point
+    for (int nHeight = nForkHeight + 1; nHeight <= chain.Height(); nHeight++) {
+        const CBlockIndex* pindex = chain[nHeight];
+        if (pindex->GeneratedStakeModifier())
+            vGenerated.push_back(pindex);
+    }
+    pindexBest = chain.Tip();
+}
+
+bool CStakeModifierIndex::GetModifierBlock(const CChain& chain, const CBlockIndex* pindexFrom, int64_t nSelectionInterval, const CBlockIndex*& pindexModifier)
+{
+    LOCK(cs);
+    Sync(chain);
+    return GetModifierBlock(pindexFrom, nSelectionInterval, pindexModifier);
+}
+
+bool CStakeModifierIndex::GetModifierBlock(const CBlockIndex* pindexFrom, int64_t nSelectionInterval, const CBlockIndex*& pindexModifier)
+{
+    LOCK(cs);
+    const int64_t nModifierTimeMin = pindexFrom->GetBlockTime() + nSelectionInterval;
+    auto it = std::upper_bound(vGenerated.begin(), vGenerated.end(), pindexFrom->nHeight,
+                               [](int nHeight, const CBlockIndex* pindex) { return nHeight < pindex->nHeight; });
+    // block times are only loosely ordered, so take the first generating
+    // block by height that is late enough, exactly as a chain walk would
+    for (; it != vGenerated.end(); ++it) {
+        if ((*it)->GetBlockTime() >= nModifierTimeMin) {
+            pindexModifier = *it;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CStakeModifierIndex::Clear()
+{
+    LOCK(cs);
+    vGenerated.clear();
+    pindexBest = nullptr;
+}
+
+void CStakeSpentIndex::Expire(Bucket& bucket)
+{
+    for (const COutPoint& outpoint : bucket.vSpent) {
+        // the outpoint may have been disconnected and spent again since
+        auto it = mapSpent.find(outpoint);
+        if (it != mapSpent.end() && it->second == bucket.nHeight)
+            mapSpent.erase(it);
+    }
+    bucket.vSpent.clear();
+    bucket.nHeight = -1;
+}
+
+void CStakeSpentIndex::ConnectBlock(const CBlock& block, int nHeight, int nMaxDepth)
+{
+    // one bucket per height in [nHeight - nMaxDepth, nHeight]
+    const size_t nBuckets = std::max(nMaxDepth, 0) + 1;
+    if (vBuckets.size() != nBuckets) {
+        Clear();
+        vBuckets.resize(nBuckets);
+    }
+
+    Bucket& bucket = vBuckets[nHeight % nBuckets];
+    size_t nExpired = 0;
+    if (bucket.nHeight != nHeight) {
+        nExpired = bucket.vSpent.size();
+        Expire(bucket);
+        bucket.nHeight = nHeight;
+    }
+
+    size_t nInserted = 0;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (mapSpent.emplace(txin.prevout, nHeight).second) {
+                bucket.vSpent.push_back(txin.prevout);
+                nInserted++;
+            }
+        }
+    }
+
+    LogPrint(BCLog::KERNEL, "%s: height %d, %u spends recorded, %u expired, %u tracked\n", __func__, nHeight, nInserted, nExpired, mapSpent.size());
+}
+
+void CStakeSpentIndex::DisconnectBlock(const CBlock& block, int nHeight)
+{
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin)
+            mapSpent.erase(txin.prevout);
+    }
+
+    if (!vBuckets.empty()) {
+        Bucket& bucket = vBuckets[nHeight % vBuckets.size()];
+        if (bucket.nHeight == nHeight) {
+            bucket.vSpent.clear();
+            bucket.nHeight = -1;
+        }
+    }
+}
+
+bool CStakeSpentIndex::GetSpentHeight(const COutPoint& outpoint, int& nHeight) const
+{
+    auto it = mapSpent.find(outpoint);
+    if (it == mapSpent.end())
+        return false;
+    nHeight = it->second;
+    return true;
+}
+
+void CStakeSpentIndex::Clear()
+{
+    vBuckets.clear();
+    mapSpent.clear();
+}
+
+void CForkSpentIndex::AddBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    if (HaveBlock(pindex))
+        return;
+
+    std::vector<COutPoint>& vSpent = mapBlockSpends[pindex];
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            vSpent.push_back(txin.prevout);
+            mapSpentBy.emplace(txin.prevout, pindex);
+        }
+    }
+    mapBlocksByHeight.emplace(pindex->nHeight, pindex);
+}
+
+bool CForkSpentIndex::IsSpentOnFork(const CTransaction& tx, const CBlockIndex* pindexPrev, const CChain& chain, const Consensus::Params& params)
+{
+    // make sure every block of the fork is indexed, usually they all are
+    const CBlockIndex* pindexFork = pindexPrev;
+    for (; pindexFork && !chain.Contains(pindexFork); pindexFork = pindexFork->pprev) {
+        if (HaveBlock(pindexFork))
+            continue;
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindexFork, params)) {
+            LogPrintf("%s: failed to read fork block %s\n", __func__, pindexFork->GetBlockHash().ToString());
+            continue;
+        }
+        AddBlock(block, pindexFork);
+    }
+    const int nForkHeight = pindexFork ? pindexFork->nHeight : -1;
+
+    for (const CTxIn& txin : tx.vin) {
+        auto range = mapSpentBy.equal_range(txin.prevout);
+        for (auto it = range.first; it != range.second; ++it) {
+            const CBlockIndex* pindex = it->second;
+            // spent by a block of this fork, above where it leaves chain
+            if (pindex->nHeight > nForkHeight && pindexPrev->GetAncestor(pindex->nHeight) == pindex)
+                return true;
         }
+    }
+    return false;
+}
 
-        pindex = pindexNext;
-        pindexNext = chainActive[pindexNext->nHeight + 1];
-        if (pindex->GeneratedStakeModifier()) {
-            nStakeModifierHeight = pindex->nHeight;
-            nStakeModifierTime = pindex->GetBlockTime();
+void CForkSpentIndex::Prune(int nMinHeight)
+{
+    auto itEnd = mapBlocksByHeight.lower_bound(nMinHeight);
+    for (auto it = mapBlocksByHeight.begin(); it != itEnd; ++it) {
+        const CBlockIndex* pindex = it->second;
+        auto itSpends = mapBlockSpends.find(pindex);
+        for (const COutPoint& outpoint : itSpends->second) {
+            auto range = mapSpentBy.equal_range(outpoint);
+            for (auto itSpent = range.first; itSpent != range.second; ++itSpent) {
+                if (itSpent->second == pindex) {
+                    mapSpentBy.erase(itSpent);
+                    break;
+                }
+            }
         }
+        mapBlockSpends.erase(itSpends);
     }
+    mapBlocksByHeight.erase(mapBlocksByHeight.begin(), itEnd);
+}
+
+void CForkSpentIndex::Clear()
+{
+    mapSpentBy.clear();
+    mapBlockSpends.clear();
+    mapBlocksByHeight.clear();
+}
+
+static bool GetKernelStakeModifierV03(const CBlockIndex* pindexFrom, unsigned int nTimeTx, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
+{
+    nStakeModifier = 0;
+    const CBlockIndex* pindex = nullptr;
+
+    // find the stake modifier later by a selection interval
+    if (!stakeModifierIndex.GetModifierBlock(chainActive, pindexFrom, GetStakeModifierSelectionInterval(), pindex))
+        return false;
+
+    nStakeModifierHeight = pindex->nHeight;
+    nStakeModifierTime = pindex->GetBlockTime();
     nStakeModifier = pindex->nStakeModifier;
     return true;
 }
 
 // Get the stake modifier specified by the protocol to hash for a stake kernel
-static bool GetKernelStakeModifier(uint256 hashBlockFrom, unsigned int nTimeTx, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
+static bool GetKernelStakeModifier(const CBlockIndex* pindexFrom, unsigned int nTimeTx, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
 {
-    return GetKernelStakeModifierV03(hashBlockFrom, nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake);
+    return GetKernelStakeModifierV03(pindexFrom, nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake);
 }
 
 uint256 stakeHash(unsigned int nTimeTx, CDataStream ss, unsigned int prevoutIndex, uint256 prevoutHash, unsigned int nTimeBlockFrom)
@@ -271,34 +503,29 @@ bool HasStakeMinDepth(int contextHeight, int utxoFromBlockHeight, int &nDepthFou
     return (nDepthFound >= minHistoryRequired);
 }
 
-int GetLastHeight(uint256 txHash)
+bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, bool fMinting, bool fValidate)
 {
-    uint256 hashBlock;
-    CTransactionRef stakeInput;
+    BlockMap::const_iterator it = mapBlockIndex.find(blockFrom.GetHash());
+    if (it == mapBlockIndex.end())
+        return error("CheckStakeKernelHash() : block not indexed");
 
-    if (!GetTransaction(txHash, stakeInput, Params().GetConsensus(), hashBlock, true))
-        return 0;
-    if (hashBlock == uint256())
-        return 0;
-
-    return mapBlockIndex[hashBlock]->nHeight;
+    return CheckStakeKernelHash(nBits, it->second, nTxPrevOffset, txPrev->vout[prevout.n].nValue, prevout, nTimeTx, hashProofOfStake, fMinting, fValidate);
 }
 
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, bool fMinting, bool fValidate)
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, unsigned int nTxPrevOffset, CAmount nValueIn, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, bool fMinting, bool fValidate)
 {
-    auto txPrevTime = blockFrom.GetBlockTime();
+    auto txPrevTime = pindexFrom->GetBlockTime();
     if (nTimeTx < txPrevTime)  // Transaction timestamp violation
         return error("CheckStakeKernelHash() : nTime violation");
 
     auto nStakeMinAge = Params().GetConsensus().nStakeMinAge;
     auto nStakeMaxAge = Params().GetConsensus().nStakeMaxAge;
-    unsigned int nTimeBlockFrom = blockFrom.GetBlockTime();
+    unsigned int nTimeBlockFrom = pindexFrom->GetBlockTime();
     if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
         return error("CheckStakeKernelHash() : min age violation");
 
     arith_uint256 bnTargetPerCoinDay;
     bnTargetPerCoinDay.SetCompact(nBits);
-    CAmount nValueIn = txPrev->vout[prevout.n].nValue;
     // v0.3 protocol kernel hash weight starts from 0 at the 30-day min age
     // this change increases active coins participating the hash and helps
     // to secure the network when proof-of-stake difficulty is low
@@ -315,7 +542,7 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     int nStakeModifierHeight = 0;
     int64_t nStakeModifierTime = 0;
 
-    if (!GetKernelStakeModifier(blockFrom.GetHash(), nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
+    if (!GetKernelStakeModifier(pindexFrom, nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
         return false;
     ss << nStakeModifier;
     ss << nTimeBlockFrom << nTxPrevOffset << txPrevTime << prevout.n << nTimeTx;
@@ -331,6 +558,64 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     return true;
 }
 
+const size_t CStakeKernelSearch::BATCH_SIZE;
+const size_t CStakeKernelSearch::PREFIX_SIZE;
+
+CStakeKernelSearch::CStakeKernelSearch(unsigned int nBits, const CBlockIndex* pindexFrom, unsigned int nTxPrevOffset, CAmount nValueInIn, const COutPoint& prevout)
+    : fValid(false), nTimeBlockFrom(pindexFrom->GetBlockTime()), nValueIn(nValueInIn)
+{
+    bnTargetPerCoinDay.SetCompact(nBits);
+    memset(prefix, 0, sizeof(prefix));
+
+    if (nValueIn < Params().GetConsensus().nMinStakeAmount)
+        return;
+
+    // the modifier GetKernelStakeModifier would pick, without syncing to chainActive
+    const CBlockIndex* pindexModifier = nullptr;
+    if (!stakeModifierIndex.GetModifierBlock(pindexFrom, GetStakeModifierSelectionInterval(), pindexModifier))
+        return;
+    const uint64_t nStakeModifier = pindexModifier->nStakeModifier;
+
+    // Same layout as CheckStakeKernelHash, without the trailing nTimeTx
+    CDataStream ss(SER_GETHASH, 0);
+    ss << nStakeModifier;
+    ss << (unsigned int)nTimeBlockFrom << nTxPrevOffset << nTimeBlockFrom << prevout.n;
+    assert(ss.size() == PREFIX_SIZE);
+    memcpy(prefix, ss.data(), PREFIX_SIZE);
+    fValid = true;
+}
+
+void CStakeKernelSearch::Hash(unsigned int nTimeTxFirst, size_t nCount, uint256* phashes) const
+{
+    assert(nCount <= BATCH_SIZE);
+    unsigned char in[BATCH_SIZE * 32];
+    unsigned char out[BATCH_SIZE * 32];
+    for (size_t i = 0; i < nCount; i++) {
+        memcpy(in + i * 32, prefix, PREFIX_SIZE);
+        WriteLE32(in + i * 32 + PREFIX_SIZE, nTimeTxFirst - i);
+    }
+    SHA256D32(out, in, nCount);
+    for (size_t i = 0; i < nCount; i++)
+        memcpy(phashes[i].begin(), out + i * 32, 32);
+}
+
+bool CStakeKernelSearch::CheckTarget(unsigned int nTimeTx, const uint256& hashProofOfStake) const
+{
+    if (!fValid || nTimeTx < nTimeBlockFrom)
+        return false;
+
+    const Consensus::Params& consensus = Params().GetConsensus();
+    if (nTimeBlockFrom + consensus.nStakeMinAge > nTimeTx)
+        return false;
+
+    if (hashProofOfStake == uint256())
+        return false;
+
+    int64_t nTimeWeight = std::min<int64_t>(nTimeTx - nTimeBlockFrom, consensus.nStakeMaxAge - consensus.nStakeMinAge);
+    arith_uint256 bnCoinDayWeight = nValueIn * nTimeWeight / COIN / 200;
+    return UintToArith256(hashProofOfStake) <= bnCoinDayWeight * bnTargetPerCoinDay;
+}
+
 bool CheckKernelScript(CScript scriptVin, CScript scriptVout)
 {
     auto extractKeyID = [](CScript scriptPubKey) {
@@ -357,36 +642,67 @@ bool CheckKernelScript(CScript scriptVin, CScript scriptVout)
     return extractKeyID(scriptVin) == extractKeyID(scriptVout);
 }
 
-// Check kernel hash target and coinstake signature
-bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake, const CBlockIndex* pindexPrev)
+// Find the output spent by a stake kernel and the block it was confirmed in
+// from the UTXO set, so no transaction index or block read is needed
+static bool GetStakeInputFromCoins(const COutPoint& prevout, CTxOut& txOutPrev, const CBlockIndex*& pindexFrom)
 {
-    const CTransactionRef &tx = block.vtx[1];
-    if (!tx->IsCoinStake())
-        return error("CheckProofOfStake() : called on non-coinstake %s", tx->GetHash().ToString().c_str());
+    AssertLockHeld(cs_main);
 
-    // Kernel (input 0) must match the stake hash target per coin age (nBits)
-    const CTxIn& txin = tx->vin[0];
+    Coin coin;
+    if (!pcoinsTip->GetCoin(prevout, coin) || coin.IsSpent())
+        return false;
+
+    pindexFrom = chainActive[coin.nHeight];
+    if (!pindexFrom)
+        return false;
+
+    txOutPrev = coin.out;
+    return true;
+}
 
-    // First try finding the previous transaction in database
+// Stakes on a fork may spend outputs that are already spent on the active
+// chain, fall back to looking up the previous transaction for those
+static bool GetStakeInputFromTransaction(const COutPoint& prevout, CTxOut& txOutPrev, const CBlockIndex*& pindexFrom)
+{
     uint256 hashBlock;
     CTransactionRef txPrev;
 
-    const auto &cons = Params().GetConsensus();
-
-    if (!GetTransaction(txin.prevout.hash, txPrev, cons, hashBlock, true))
+    if (!GetTransaction(prevout.hash, txPrev, Params().GetConsensus(), hashBlock, true))
         return error("CheckProofOfStake() : INFO: read txPrev failed");
 
-    CTxOut prevTxOut = txPrev->vout[txin.prevout.n];
-    CBlockIndex* pindex = NULL;
+    if (prevout.n >= txPrev->vout.size())
+        return error("CheckProofOfStake() : INFO: txPrev has no output %u", prevout.n);
+
     BlockMap::iterator it = mapBlockIndex.find(hashBlock);
-    if (it != mapBlockIndex.end())
-        pindex = it->second;
-    else
+    if (it == mapBlockIndex.end())
         return error("CheckProofOfStake() : read block failed");
 
+    txOutPrev = txPrev->vout[prevout.n];
+    pindexFrom = it->second;
+    return true;
+}
+
+// Check kernel hash target and coinstake signature
+bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake, const CBlockIndex* pindexPrev)
+{
+    const CTransactionRef &tx = block.vtx[1];
+    if (!tx->IsCoinStake())
+        return error("CheckProofOfStake() : called on non-coinstake %s", tx->GetHash().ToString().c_str());
+
+    // Kernel (input 0) must match the stake hash target per coin age (nBits)
+    const CTxIn& txin = tx->vin[0];
+
+    // Value, script and height of the kernel come from the coin it spends,
+    // the time of its block from the block index
+    CTxOut prevTxOut;
+    const CBlockIndex* pindexFrom = nullptr;
+    if (!GetStakeInputFromCoins(txin.prevout, prevTxOut, pindexFrom) &&
+            !GetStakeInputFromTransaction(txin.prevout, prevTxOut, pindexFrom))
+        return false;
+
     //! test depth
     const int nPreviousBlockHeight = pindexPrev->nHeight;
-    const int nBlockFromHeight = GetLastHeight(txin.prevout.hash);
+    const int nBlockFromHeight = pindexFrom->nHeight;
 
     if (nBlockFromHeight == 0)
         return false;
@@ -395,16 +711,11 @@ bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake, const CBl
     if (!HasStakeMinDepth(nPreviousBlockHeight+1, nBlockFromHeight, nDepthFound))
         return error("CheckProofOfStake() : min stake depth not met (need: %d found: %d)", Params().GetConsensus().nMinStakeHistory, nDepthFound);
 
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos(), cons))
-        return error("CheckProofOfStake(): INFO: failed to find block");
-
     if(!CheckKernelScript(prevTxOut.scriptPubKey, tx->vout[1].scriptPubKey))
         return error("CheckProofOfStake() : INFO: check kernel script failed on coinstake %s, hashProof=%s \n", tx->GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str());
 
     unsigned int nTime = block.nTime;
-    if (!CheckStakeKernelHash(block.nBits, blockprev, sizeof(CBlock), txPrev, txin.prevout, nTime, hashProofOfStake, false, true))
+    if (!CheckStakeKernelHash(block.nBits, pindexFrom, sizeof(CBlock), prevTxOut.nValue, txin.prevout, nTime, hashProofOfStake, false, true))
         return error("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s \n", tx->GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str()); // may occur during initial download or if behind on block chain sync
 
     return true;
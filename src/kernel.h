@@ -7,12 +7,23 @@
 #include <uint256.h>
 #include <streams.h>
 #include <arith_uint256.h>
+#include <amount.h>
+#include <coins.h>
 #include <primitives/transaction.h>
+#include <sync.h>
+
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
 
 class CBlock;
 class CWallet;
 class COutPoint;
 class CBlockIndex;
+class CChain;
+
+namespace Consensus { struct Params; }
 
 // MODIFIER_INTERVAL: time to elapse before new modifier is computed
 static const unsigned int MODIFIER_INTERVAL = 60;
@@ -24,6 +35,146 @@ extern unsigned int getIntervalVersion(bool fTestNet);
 // ratio of group interval length between the last group and the first group
 static const int MODIFIER_INTERVAL_RATIO = 3;
 
+/**
+ * Active chain blocks that generated a new stake modifier, ordered by height.
+ * Lets the kernel find the modifier one selection interval after the block a
+ * stake comes from without walking chainActive block by block. The index is
+ * brought in line with the chain it is queried against, so blocks disconnected
+ * since the last lookup are dropped and newly connected ones are appended.
+ */
+class CStakeModifierIndex
+{
+private:
+    mutable CCriticalSection cs;
+    std::vector<const CBlockIndex*> vGenerated;
+    //! Chain tip the index was last synced to
+    const CBlockIndex* pindexBest = nullptr;
+
+public:
+    /** Bring the index in line with chain, which must not change meanwhile (cs_main for chainActive) */
+    void Sync(const CChain& chain);
+    /**
+     * Find the first block on chain above pindexFrom that generated a stake
+     * modifier at or after pindexFrom's time plus nSelectionInterval.
+     * Returns false if the chain has not reached that point yet.
+     */
+    bool GetModifierBlock(const CChain& chain, const CBlockIndex* pindexFrom, int64_t nSelectionInterval, const CBlockIndex*& pindexModifier);
+    /** Same lookup on the chain the index was last synced to, without reading any chain */
+    bool GetModifierBlock(const CBlockIndex* pindexFrom, int64_t nSelectionInterval, const CBlockIndex*& pindexModifier);
+    void Clear();
+};
+
+extern CStakeModifierIndex stakeModifierIndex;
+
+/**
+ * Candidate blocks for stake modifier selection, kept between successive
+ * calls to ComputeNextStakeModifier. The candidates for a block are the
+ * blocks below it back to the start of the selection interval, so most of
+ * them are shared with the previous block: the window is moved along the
+ * chain (following reorganizations) instead of being rebuilt, and the
+ * selection hash of each candidate, which only depends on the previous stake
+ * modifier, is computed once instead of once per selection round.
+ */
+class CStakeModifierCandidates
+{
+private:
+    struct Candidate {
+        const CBlockIndex* pindex;
+        //! Stake modifier hashSelection was computed with
+        uint64_t nModifierPrev;
+        bool fHashed;
+        arith_uint256 hashSelection;
+
+        explicit Candidate(const CBlockIndex* pindexIn) : pindex(pindexIn), nModifierPrev(0), fHashed(false) {}
+    };
+
+    mutable CCriticalSection cs;
+    //! Candidates ordered by height, ending at the last block selected for
+    std::deque<Candidate> vWindow;
+
+    void MoveWindow(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart);
+
+public:
+    /**
+     * Select the blocks whose entropy bits make up the stake modifier that
+     * follows pindexPrev, one per round in round order. nHeightFirstCandidate
+     * is set to the lowest height that was a candidate.
+     */
+    bool SelectBlocks(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart, uint64_t nStakeModifierPrev,
+                      std::vector<const CBlockIndex*>& vSelected, int& nHeightFirstCandidate);
+    void Clear();
+};
+
+extern CStakeModifierCandidates stakeModifierCandidates;
+
+/**
+ * Outputs spent by the last blocks of the active chain, with the height they
+ * were spent at. A stake on a fork may use an output that is already spent at
+ * the tip, which is accepted if the spend happened above the fork point.
+ *
+ * Spends are kept in a ring of per-height buckets covering the maximum
+ * reorganization depth, plus a hash index for lookups. Connecting a block
+ * expires only the bucket that falls out of the window, so memory is bounded
+ * by the inputs of that many blocks. Guarded by cs_main.
+ */
+class CStakeSpentIndex
+{
+private:
+    struct Bucket {
+        int nHeight = -1;
+        std::vector<COutPoint> vSpent;
+    };
+
+    std::vector<Bucket> vBuckets;
+    std::unordered_map<COutPoint, int, SaltedOutpointHasher> mapSpent;
+
+    void Expire(Bucket& bucket);
+
+public:
+    //! Record the inputs of a block connected at nHeight, forgetting spends older than nMaxDepth blocks
+    void ConnectBlock(const CBlock& block, int nHeight, int nMaxDepth);
+    //! Forget the inputs of a block disconnected from nHeight
+    void DisconnectBlock(const CBlock& block, int nHeight);
+    //! Height the outpoint was spent at, if it was spent within the window
+    bool GetSpentHeight(const COutPoint& outpoint, int& nHeight) const;
+    size_t size() const { return mapSpent.size(); }
+    void Clear();
+};
+
+/**
+ * Outputs spent by blocks we have accepted, keyed by the block that spent
+ * them, so a stake on a side chain can be checked for spending an output that
+ * an earlier block of the same fork already spent without reading the fork
+ * blocks back from disk. Blocks are added when accepted (or lazily the first
+ * time a fork walk meets one that is missing, e.g. after a restart) and are
+ * forgotten once they are deeper than the reorganization limit.
+ * Guarded by cs_main.
+ */
+class CForkSpentIndex
+{
+private:
+    std::unordered_multimap<COutPoint, const CBlockIndex*, SaltedOutpointHasher> mapSpentBy;
+    std::unordered_map<const CBlockIndex*, std::vector<COutPoint>> mapBlockSpends;
+    std::multimap<int, const CBlockIndex*> mapBlocksByHeight;
+
+public:
+    //! Record the inputs spent by block
+    void AddBlock(const CBlock& block, const CBlockIndex* pindex);
+    bool HaveBlock(const CBlockIndex* pindex) const { return mapBlockSpends.count(pindex); }
+
+    /**
+     * Whether any block between pindexPrev and its fork point with chain
+     * spends one of the inputs of tx. Fork blocks that are not indexed yet
+     * are read from disk once and added.
+     */
+    bool IsSpentOnFork(const CTransaction& tx, const CBlockIndex* pindexPrev, const CChain& chain, const Consensus::Params& params);
+
+    //! Forget blocks below nMinHeight
+    void Prune(int nMinHeight);
+    size_t size() const { return mapSpentBy.size(); }
+    void Clear();
+};
+
 // Compute the hash modifier for proof-of-stake
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
@@ -32,6 +183,46 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
 bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned int nTxPrevOffset,
                           const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx,
                           uint256& hashProofOfStake, bool fMinting = true, bool fValidate = true);
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, unsigned int nTxPrevOffset,
+                          CAmount nValueIn, const COutPoint& prevout, unsigned int nTimeTx,
+                          uint256& hashProofOfStake, bool fMinting = true, bool fValidate = true);
+
+/**
+ * Stake kernel hashing for one output across many candidate timestamps.
+ * Everything in the kernel except nTimeTx is fixed for a given output, so the
+ * stake modifier is looked up once and the invariant part of the kernel is
+ * serialized once. Kernels are then double-SHA256'd in batches, which lets
+ * SHA256D32 use the multi-way SSE4.1/AVX2 transforms where available.
+ * The modifier comes from stakeModifierIndex as last synced, so that search
+ * threads don't read chainActive; sync it under cs_main first.
+ */
+class CStakeKernelSearch
+{
+public:
+    //! Number of timestamps worth hashing per call to Hash()
+    static const size_t BATCH_SIZE = 8;
+
+    CStakeKernelSearch(unsigned int nBits, const CBlockIndex* pindexFrom, unsigned int nTxPrevOffset,
+                       CAmount nValueIn, const COutPoint& prevout);
+
+    //! False if the output cannot stake (no stake modifier yet or below the minimum amount)
+    bool IsValid() const { return fValid; }
+
+    //! Compute kernel hashes for nTimeTxFirst, nTimeTxFirst - 1, ... (at most BATCH_SIZE)
+    void Hash(unsigned int nTimeTxFirst, size_t nCount, uint256* phashes) const;
+
+    //! Whether the kernel hash for nTimeTx meets the weighted target, as CheckStakeKernelHash does
+    bool CheckTarget(unsigned int nTimeTx, const uint256& hashProofOfStake) const;
+
+private:
+    static const size_t PREFIX_SIZE = 28;
+
+    bool fValid;
+    int64_t nTimeBlockFrom;
+    CAmount nValueIn;
+    arith_uint256 bnTargetPerCoinDay;
+    unsigned char prefix[PREFIX_SIZE];
+};
 
 // wrapper for checkstakekernelhash (5g routine) for traditional method
 bool CheckStake(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake);
@@ -50,7 +50,11 @@ CMasternode::CMasternode(const CMasternode& other) :
     nPoSeBanScore(other.nPoSeBanScore),
     nPoSeBanHeight(other.nPoSeBanHeight),
     fAllowMixingTx(other.fAllowMixingTx),
-    fUnitTest(other.fUnitTest)
+    fUnitTest(other.fUnitTest),
+    fCollateralCached(other.fCollateralCached),
+    nCollateralValue(other.nCollateralValue),
+    nCollateralType(other.nCollateralType),
+    nCollateralHeight(other.nCollateralHeight)
 {}
 
 CMasternode::CMasternode(const CMasternodeBroadcast& mnb) :
@@ -171,8 +175,7 @@ void CMasternode::Check(bool fForce)
 
     int nHeight = 0;
     if(!fUnitTest) {
-        CollateralStatus err = CheckCollateral(vin.prevout);
-        if (err == COLLATERAL_UTXO_NOT_FOUND) {
+        if (GetCollateralHeight() == -1) {
             nActiveState = MASTERNODE_OUTPOINT_SPENT;
             LogPrint(BCLog::MASTERNODE, "CMasternode::Check -- Failed to find Masternode UTXO, masternode=%s\n", vin.prevout.ToString());
             return;
@@ -868,8 +871,7 @@ bool CMasternodePing::CheckAndUpdate(CMasternode* pmn, bool fFromNewBroadcast, i
     pmn->lastPing = *this;
 
     // and update mnodeman.mapSeenMasternodeBroadcast.lastPing which is probably outdated
-    CMasternodeBroadcast mnb(*pmn);
-    uint256 hash = mnb.GetHash();
+    uint256 hash = pmn->GetBroadcastHash();
     if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
         mnodeman.mapSeenMasternodeBroadcast[hash].second.lastPing = *this;
     }
@@ -924,18 +926,58 @@ CAmount CMasternode::CheckOutPointValue(const COutPoint& outpoint) const
     return coin.out.nValue;
 }
 
-int CMasternode::RetrieveMNType() const
+void CMasternode::UpdateCollateralCache() const
 {
-    CAmount nOutPointValue = CheckOutPointValue(vin.prevout);
+    AssertLockHeld(cs_main);
+    if (fCollateralCached) return;
+
+    Coin coin;
+    if (GetUTXOCoin(vin.prevout, coin)) {
+        nCollateralValue = coin.out.nValue;
+        nCollateralHeight = coin.nHeight;
+    } else {
+        nCollateralValue = 0;
+        nCollateralHeight = -1;
+    }
+
+    nCollateralType = -1;
     for(int i=0; i<Params().CollateralLevels(); i++) {
-        if(nOutPointValue == (Params().ValidCollateralAmounts()[i] * COIN)) {
+        if(nCollateralValue == (Params().ValidCollateralAmounts()[i] * COIN)) {
            if (gArgs.IsArgSet("-debug"))
-               LogPrintf("%s - (value: %llu, mnType: %i)\n", __func__, nOutPointValue, i);
-           return i; 
-	}
+               LogPrintf("%s - (value: %llu, mnType: %i)\n", __func__, nCollateralValue, i);
+           nCollateralType = i;
+           break;
+        }
     }
+    if (nCollateralType == -1)
+        LogPrintf("%s - could not locate valid collateral amount (found %llu, not good)\n", __func__, nCollateralValue);
+
+    fCollateralCached = true;
+}
+
+int CMasternode::RetrieveMNType() const
+{
+    UpdateCollateralCache();
+    return nCollateralType;
+}
 
-    LogPrintf("%s - could not locate valid collateral amount (found %llu, not good)\n", __func__, nOutPointValue);
-    return -1;
+int CMasternode::GetCollateralHeight() const
+{
+    UpdateCollateralCache();
+    return nCollateralHeight;
+}
+
+uint256 CMasternode::GetBroadcastHash() const
+{
+    // vin and pubKeyCollateralAddress are fixed for an entry, a newer broadcast changes sigTime
+    if (hashBroadcast.IsNull() || nHashBroadcastSigTime != sigTime) {
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << vin;
+        ss << pubKeyCollateralAddress;
+        ss << sigTime;
+        hashBroadcast = ss.GetHash();
+        nHashBroadcastSigTime = sigTime;
+    }
+    return hashBroadcast;
 }
 
@@ -165,6 +165,17 @@ public:
     bool fAllowMixingTx{};
     bool fUnitTest = false;
 
+    // collateral value, tier and height looked up from the UTXO set once and reset by
+    // CMasternodeMan whenever a block spends or creates the collateral outpoint, protected by cs_main
+    mutable bool fCollateralCached{false};
+    mutable CAmount nCollateralValue{0};
+    mutable int nCollateralType{-1};
+    mutable int nCollateralHeight{-1};
+
+    // hash of the broadcast this entry came from and the sigTime it was computed for
+    mutable uint256 hashBroadcast{};
+    mutable int64_t nHashBroadcastSigTime{0};
+
     // KEEP TRACK OF GOVERNANCE ITEMS EACH MASTERNODE HAS VOTE UPON FOR RECALCULATION
     std::map<uint256, int> mapGovernanceObjectsVotedOn;
 
@@ -223,6 +234,13 @@ public:
 
     CAmount CheckOutPointValue(const COutPoint& outpoint) const;
     int RetrieveMNType() const;
+    /// Height of the collateral, -1 if it is unknown or already spent
+    int GetCollateralHeight() const;
+    void UpdateCollateralCache() const;
+    void InvalidateCollateralCache() { fCollateralCached = false; }
+
+    /// Same as CMasternodeBroadcast(*this).GetHash() without copying the entry
+    uint256 GetBroadcastHash() const;
     bool IsEnabled() const;
     bool IsPreEnabled() const { return nActiveState == MASTERNODE_PRE_ENABLED; }
     bool IsPoSeBanned() const { return nActiveState == MASTERNODE_POSE_BAN; }
@@ -292,6 +310,10 @@ public:
         nPoSeBanHeight = from.nPoSeBanHeight;
         fAllowMixingTx = from.fAllowMixingTx;
         fUnitTest = from.fUnitTest;
+        fCollateralCached = from.fCollateralCached;
+        nCollateralValue = from.nCollateralValue;
+        nCollateralType = from.nCollateralType;
+        nCollateralHeight = from.nCollateralHeight;
         mapGovernanceObjectsVotedOn = from.mapGovernanceObjectsVotedOn;
         return *this;
     }
@@ -28,42 +28,8 @@ static bool GetBlockHash(uint256 &hash, int nBlockHeight)
     return false;
 }
 
-static bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin)
-{
-    LOCK(cs_main);
-    if (!pcoinsTip->GetCoin(outpoint, coin))
-        return false;
-    if (coin.IsSpent())
-        return false;
-    return true;
-}
-
-static int GetUTXOHeight(const COutPoint& outpoint)
-{
-    // -1 means UTXO is yet unknown or already spent
-    Coin coin;
-    return GetUTXOCoin(outpoint, coin) ? coin.nHeight : -1;
-}
-
-static int GetUTXOConfirmations(const COutPoint& outpoint)
-{
-    // -1 means UTXO is yet unknown or already spent
-    LOCK(cs_main);
-    int nPrevoutHeight = GetUTXOHeight(outpoint);
-    return (nPrevoutHeight > -1 && chainActive.Tip()) ? chainActive.Height() - nPrevoutHeight + 1 : -1;
-}
-
 const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-7";
 
-struct CompareLastPaidBlock
-{
-    bool operator()(const std::pair<int, const CMasternode*>& t1,
-                    const std::pair<int, const CMasternode*>& t2) const
-    {
-        return (t1.first != t2.first) ? (t1.first < t2.first) : (t1.second->vin < t2.second->vin);
-    }
-};
-
 struct CompareScoreMN
 {
     bool operator()(const std::pair<arith_uint256, CMasternode*>& t1,
@@ -97,6 +63,14 @@ CMasternodeMan::CMasternodeMan()
       fMasternodesRemoved(false),
       vecDirtyGovernanceObjectHashes(),
       nLastWatchdogVoteTime(0),
+      mapRankCache(),
+      vecPaymentQueues(),
+      fPaymentQueuesDirty(true),
+      queueCheckDeadlines(),
+      mapCheckDeadlines(),
+      fCheckDeadlinesDirty(false),
+      snapshot(std::make_shared<const snapshot_t>()),
+      fSnapshotDirty(false),
       mapSeenMasternodeBroadcast(),
       mapSeenMasternodePing(),
       nDsqCount(0)
@@ -106,11 +80,15 @@ bool CMasternodeMan::Add(CMasternode &mn)
 {
     LOCK(cs);
 
-    if (Has(mn.vin.prevout)) return false;
+    if (mapMasternodes.count(mn.vin.prevout)) return false;
 
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.vin.prevout] = mn;
     fMasternodesAdded = true;
+    InvalidateRankCache();
+    fPaymentQueuesDirty = true;
+    ScheduleCheck(mn.vin.prevout, mn.nTimeLastChecked + MASTERNODE_CHECK_SECONDS);
+    PublishSnapshot();
     return true;
 }
 
@@ -187,8 +165,40 @@ void CMasternodeMan::Check()
 
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
-    for (auto& mnpair : mapMasternodes) {
-        mnpair.second.Check();
+    if (fCheckDeadlinesDirty) {
+        queueCheckDeadlines = decltype(queueCheckDeadlines)();
+        mapCheckDeadlines.clear();
+        for (const auto& mnpair : mapMasternodes) {
+            ScheduleCheck(mnpair.first, mnpair.second.nTimeLastChecked + MASTERNODE_CHECK_SECONDS);
+        }
+        fCheckDeadlinesDirty = false;
+    }
+
+    // only visit the masternodes that are due, CMasternode::Check() would skip the others anyway
+    int64_t nNow = GetTime();
+    bool fStateChanged = false;
+    while (!queueCheckDeadlines.empty() && queueCheckDeadlines.top().first <= nNow) {
+        check_deadline_t deadline = queueCheckDeadlines.top();
+        queueCheckDeadlines.pop();
+
+        auto itDeadline = mapCheckDeadlines.find(deadline.second);
+        if (itDeadline == mapCheckDeadlines.end() || itDeadline->second != deadline.first) continue;
+
+        auto it = mapMasternodes.find(deadline.second);
+        if (it == mapMasternodes.end()) {
+            mapCheckDeadlines.erase(itDeadline);
+            continue;
+        }
+
+        int nActiveStatePrev = it->second.nActiveState;
+        it->second.Check();
+        fStateChanged |= it->second.nActiveState != nActiveStatePrev;
+        ScheduleCheck(it->first, std::max(it->second.nTimeLastChecked + MASTERNODE_CHECK_SECONDS, nNow + 1));
+    }
+
+    // at most once per tick, for the states changed here and entries changed in place since
+    if (fStateChanged || fSnapshotDirty) {
+        PublishSnapshot();
     }
 }
 
@@ -211,8 +221,7 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
         std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.begin();
         while (it != mapMasternodes.end()) {
-            CMasternodeBroadcast mnb = CMasternodeBroadcast(it->second);
-            uint256 hash = mnb.GetHash();
+            uint256 hash = it->second.GetBroadcastHash();
             // If collateral was spent ...
             if (it->second.IsOutpointSpent() ||
                 it->second.IsExpired()) {
@@ -223,8 +232,12 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
                 mWeAskedForMasternodeListEntry.erase(it->first);
 
                 // and finally remove it from the list
+                mapCheckDeadlines.erase(it->first);
                 mapMasternodes.erase(it++);
                 fMasternodesRemoved = true;
+                InvalidateRankCache();
+                fPaymentQueuesDirty = true;
+                fSnapshotDirty = true;
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
                         masternodeSync.IsSynced() &&
@@ -280,6 +293,11 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
                 ++itMnbReplies;
             }
         }
+
+        // readers must not find removed masternodes anymore
+        if (fSnapshotDirty) {
+            PublishSnapshot();
+        }
     }
     {
         // no need for cm_main below
@@ -379,6 +397,10 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     mapMasternodes.clear();
+    InvalidateRankCache();
+    fPaymentQueuesDirty = true;
+    fCheckDeadlinesDirty = true;
+    PublishSnapshot();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -457,6 +479,8 @@ void CMasternodeMan::DsegUpdate(CNode* pnode, CConnman& connman)
 CMasternode* CMasternodeMan::Find(const COutPoint &outpoint)
 {
     LOCK(cs);
+    // the caller may modify the entry, the next Check() publishes it
+    fSnapshotDirty = true;
     auto it = mapMasternodes.find(outpoint);
     return it == mapMasternodes.end() ? nullptr : &(it->second);
 }
@@ -476,44 +500,48 @@ bool CMasternodeMan::Get(const COutPoint& outpoint, CMasternode& masternodeRet)
 
 bool CMasternodeMan::IsMasternodeCollateral(const COutPoint& outpoint)
 {
-    LOCK(cs);
-    auto it = mapMasternodes.find(outpoint);
-    if (it == mapMasternodes.end()) {
-        return false;
-    }
-    return true;
+    return Has(outpoint);
 }
 
 bool CMasternodeMan::GetMasternodeInfo(const COutPoint& outpoint, masternode_info_t& mnInfoRet)
 {
-    LOCK(cs);
-    auto it = mapMasternodes.find(outpoint);
-    if (it == mapMasternodes.end()) {
+    std::shared_ptr<const snapshot_t> pSnapshot = GetSnapshot();
+    auto it = pSnapshot->mapInfo.find(outpoint);
+    if (it == pSnapshot->mapInfo.end()) {
         return false;
     }
-    mnInfoRet = it->second.GetInfo();
+    mnInfoRet = it->second;
     return true;
 }
 
+int CMasternodeMan::GetMasternodeTier(const COutPoint& outpoint)
+{
+    LOCK2(cs_main, cs);
+    CMasternode* pmn = Find(outpoint);
+    if (!pmn) {
+        return -1;
+    }
+    return pmn->RetrieveMNType();
+}
+
 bool CMasternodeMan::GetMasternodeInfo(const CPubKey& pubKeyMasternode, masternode_info_t& mnInfoRet)
 {
-    LOCK(cs);
-    for (auto& mnpair : mapMasternodes) {
-        if (mnpair.second.pubKeyMasternode == pubKeyMasternode) {
-            mnInfoRet = mnpair.second.GetInfo();
-            return true;
-        }
+    std::shared_ptr<const snapshot_t> pSnapshot = GetSnapshot();
+    auto it = pSnapshot->mapByPubKeyMasternode.find(pubKeyMasternode);
+    if (it == pSnapshot->mapByPubKeyMasternode.end()) {
+        return false;
     }
-    return false;
+    mnInfoRet = pSnapshot->mapInfo.at(it->second);
+    return true;
 }
 
 bool CMasternodeMan::GetMasternodeInfo(const CScript& payee, masternode_info_t& mnInfoRet)
 {
-    LOCK(cs);
-    for (auto& mnpair : mapMasternodes) {
-        CScript scriptCollateralAddress = GetScriptForDestination(mnpair.second.pubKeyCollateralAddress.GetID());
+    std::shared_ptr<const snapshot_t> pSnapshot = GetSnapshot();
+    for (const auto& infopair : pSnapshot->mapInfo) {
+        CScript scriptCollateralAddress = GetScriptForDestination(infopair.second.pubKeyCollateralAddress.GetID());
         if (scriptCollateralAddress == payee) {
-            mnInfoRet = mnpair.second.GetInfo();
+            mnInfoRet = infopair.second;
             return true;
         }
     }
@@ -522,8 +550,37 @@ bool CMasternodeMan::GetMasternodeInfo(const CScript& payee, masternode_info_t&
 
 bool CMasternodeMan::Has(const COutPoint& outpoint)
 {
-    LOCK(cs);
-    return mapMasternodes.find(outpoint) != mapMasternodes.end();
+    std::shared_ptr<const snapshot_t> pSnapshot = GetSnapshot();
+    return pSnapshot->mapInfo.count(outpoint) > 0;
+}
+
+void CMasternodeMan::ScheduleCheck(const COutPoint& outpoint, int64_t nTime)
+{
+    AssertLockHeld(cs);
+    mapCheckDeadlines[outpoint] = nTime;
+    queueCheckDeadlines.push(std::make_pair(nTime, outpoint));
+}
+
+void CMasternodeMan::PublishSnapshot()
+{
+    AssertLockHeld(cs);
+
+    std::shared_ptr<snapshot_t> pSnapshot = std::make_shared<snapshot_t>();
+    for (const auto& mnpair : mapMasternodes) {
+        pSnapshot->mapInfo.emplace_hint(pSnapshot->mapInfo.end(), mnpair.first, mnpair.second.GetInfo());
+        // keep the first match like the scan over the list did
+        pSnapshot->mapByPubKeyMasternode.emplace(mnpair.second.pubKeyMasternode, mnpair.first);
+    }
+
+    fSnapshotDirty = false;
+    LOCK(cs_snapshot);
+    snapshot = pSnapshot;
+}
+
+std::shared_ptr<const CMasternodeMan::snapshot_t> CMasternodeMan::GetSnapshot() const
+{
+    LOCK(cs_snapshot);
+    return snapshot;
 }
 
 bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCountRet, masternode_info_t& mnInfoRet, int mnType)
@@ -537,20 +594,11 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
 
     LOCK2(cs_main,cs);
 
-    int nMnCount = CountMasternodes();
-    std::vector<std::pair<int, const CMasternode*> > vecMasternodeLastPaid;
+    if (fPaymentQueuesDirty)
+        RebuildPaymentQueues();
 
-    for (const auto& mnpair : mapMasternodes) {
-        if(!mnpair.second.IsValidForPayment()) continue;
-        if(mnpair.second.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
-        if(fFilterSigTime && mnpair.second.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
-        if(GetUTXOConfirmations(mnpair.first) < Params().GetConsensus().nMasternodeMinimumConfirmations) continue;
-        if(mnpair.second.RetrieveMNType() != mnType) continue;
-        vecMasternodeLastPaid.push_back(std::make_pair(mnpair.second.GetLastPaidBlock(), &mnpair.second));
-    }
-
-    nCountRet = (int)vecMasternodeLastPaid.size();
-    sort(vecMasternodeLastPaid.begin(), vecMasternodeLastPaid.end(), CompareLastPaidBlock());
+    if (mnType < 0 || mnType >= (int)vecPaymentQueues.size())
+        return false;
 
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight - 101)) {
@@ -558,17 +606,37 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
         return false;
     }
 
-    int mnRecursive = 0;
+    int nMnCount = CountMasternodes();
+    // collateral must have at least nMasternodeMinimumConfirmations
+    int nMaxCollateralHeight = chainActive.Height() + 1 - Params().GetConsensus().nMasternodeMinimumConfirmations;
+
+    // walk the queue from the masternode paid longest ago, the first 11 eligible ones take part in the election
     arith_uint256 nHighest = 0;
     const CMasternode *pBestMasternode = nullptr;
-    for (const auto& s : vecMasternodeLastPaid) {
-        ++mnRecursive;
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
-        if(nScore > nHighest && s.second->RetrieveMNType() == mnType){
+    for (const auto& entry : vecPaymentQueues[mnType]) {
+        auto it = mapMasternodes.find(entry.second);
+        if (it == mapMasternodes.end()) continue;
+        CMasternode& mn = it->second;
+        if(!mn.IsValidForPayment()) continue;
+        if(mn.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
+        if(fFilterSigTime && mn.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
+        int nCollateralHeight = mn.GetCollateralHeight();
+        if(nCollateralHeight == -1 || nCollateralHeight > nMaxCollateralHeight) continue;
+        // UpdateCollaterals runs from the validation interface queue and may not
+        // have seen the latest blocks yet, don't elect a spent collateral
+        Coin coin;
+        if(!pcoinsTip->GetCoin(mn.vin.prevout, coin) || coin.IsSpent()) {
+            mn.InvalidateCollateralCache();
+            fPaymentQueuesDirty = true;
+            continue;
+        }
+
+        arith_uint256 nScore = mn.CalculateScore(blockHash);
+        if(nScore > nHighest){
             nHighest = nScore;
-            pBestMasternode = s.second;
+            pBestMasternode = &mn;
         }
-        if (mnRecursive > 10) break;
+        if (++nCountRet > 10) break;
     }
 
     if (pBestMasternode)
@@ -643,6 +711,44 @@ bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeM
     return !vecMasternodeScoresRet.empty();
 }
 
+const CMasternodeMan::rank_cache_entry_t* CMasternodeMan::GetRankCacheEntry(int nBlockHeight, const uint256& nBlockHash, int nMinProtocol)
+{
+    AssertLockHeld(cs);
+
+    const std::pair<int, int> key = std::make_pair(nBlockHeight, nMinProtocol);
+    auto it = mapRankCache.find(key);
+    // a reorg could have replaced the block at this height
+    if (it != mapRankCache.end() && it->second.nBlockHash == nBlockHash)
+        return &it->second;
+
+    score_pair_vec_t vecMasternodeScores;
+    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+        return nullptr;
+
+    if (it == mapRankCache.end()) {
+        // forget the oldest blocks first
+        while (mapRankCache.size() >= RANK_CACHE_MAX_ENTRIES) {
+            mapRankCache.erase(mapRankCache.begin());
+        }
+        it = mapRankCache.emplace(key, rank_cache_entry_t()).first;
+    }
+
+    rank_cache_entry_t& entry = it->second;
+    entry.nBlockHash = nBlockHash;
+    entry.vecOutpoints.clear();
+    entry.vecOutpoints.reserve(vecMasternodeScores.size());
+    entry.mapRanks.clear();
+    entry.mapRanks.reserve(vecMasternodeScores.size());
+    int nRank = 0;
+    for (const auto& scorePair : vecMasternodeScores) {
+        nRank++;
+        entry.vecOutpoints.push_back(scorePair.second->vin.prevout);
+        entry.mapRanks.emplace(scorePair.second->vin.prevout, nRank);
+    }
+
+    return &entry;
+}
+
 bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet, int nBlockHeight, int nMinProtocol)
 {
     nRankRet = -1;
@@ -659,20 +765,16 @@ bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet,
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    const rank_cache_entry_t* pentry = GetRankCacheEntry(nBlockHeight, nBlockHash, nMinProtocol);
+    if (!pentry)
         return false;
 
-    int nRank = 0;
-    for (auto& scorePair : vecMasternodeScores) {
-        nRank++;
-        if(scorePair.second->vin.prevout == outpoint) {
-            nRankRet = nRank;
-            return true;
-        }
-    }
+    auto it = pentry->mapRanks.find(outpoint);
+    if (it == pentry->mapRanks.end())
+        return false;
 
-    return false;
+    nRankRet = it->second;
+    return true;
 }
 
 bool CMasternodeMan::GetMasternodeRanks(CMasternodeMan::rank_pair_vec_t& vecMasternodeRanksRet, int nBlockHeight, int nMinProtocol)
@@ -691,14 +793,15 @@ bool CMasternodeMan::GetMasternodeRanks(CMasternodeMan::rank_pair_vec_t& vecMast
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    const rank_cache_entry_t* pentry = GetRankCacheEntry(nBlockHeight, nBlockHash, nMinProtocol);
+    if (!pentry)
         return false;
 
+    vecMasternodeRanksRet.reserve(pentry->vecOutpoints.size());
     int nRank = 0;
-    for (auto& scorePair : vecMasternodeScores) {
+    for (const auto& outpoint : pentry->vecOutpoints) {
         nRank++;
-        vecMasternodeRanksRet.push_back(std::make_pair(nRank, *scorePair.second));
+        vecMasternodeRanksRet.push_back(std::make_pair(nRank, mapMasternodes.at(outpoint)));
     }
 
     return true;
@@ -1339,8 +1442,12 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& co
             masternodeSync.BumpAssetLastTime("CMasternodeMan::UpdateMasternodeList - new");
         }
     } else {
-        CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
+        CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[pmn->GetBroadcastHash()].second;
+        // protocol version might change
+        InvalidateRankCache();
         if(pmn->UpdateFromNewBroadcast(mnb, connman)) {
+            // the new broadcast resets the state, check it on the next tick
+            ScheduleCheck(mnb.vin.prevout, 0);
             masternodeSync.BumpAssetLastTime("CMasternodeMan::UpdateMasternodeList - seen");
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
         }
@@ -1402,7 +1509,9 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         // search Masternode list
         CMasternode* pmn = Find(mnb.vin.prevout);
         if(pmn) {
-            CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
+            CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[pmn->GetBroadcastHash()].second;
+            // protocol version might change
+            InvalidateRankCache();
             if(!mnb.Update(pmn, nDos, connman)) {
                 LogPrint(BCLog::MASTERNODE, "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- Update() failed, masternode=%s\n", mnb.vin.prevout.ToString());
                 return false;
@@ -1441,6 +1550,47 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
     return true;
 }
 
+void CMasternodeMan::UpdateCollaterals(const CBlock& block)
+{
+    LOCK2(cs_main, cs);
+
+    if (mapMasternodes.empty()) return;
+
+    // reset the cached collateral of every masternode whose outpoint was spent or created
+    for (const auto& tx : block.vtx) {
+        for (const auto& txin : tx->vin) {
+            auto it = mapMasternodes.find(txin.prevout);
+            if (it != mapMasternodes.end()) {
+                it->second.InvalidateCollateralCache();
+                fPaymentQueuesDirty = true;
+            }
+        }
+        const uint256& txid = tx->GetHash();
+        for (unsigned int i = 0; i < tx->vout.size(); i++) {
+            auto it = mapMasternodes.find(COutPoint(txid, i));
+            if (it != mapMasternodes.end()) {
+                it->second.InvalidateCollateralCache();
+                fPaymentQueuesDirty = true;
+            }
+        }
+    }
+}
+
+void CMasternodeMan::RebuildPaymentQueues()
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs);
+
+    vecPaymentQueues.assign(Params().CollateralLevels(), payment_queue_t());
+    for (const auto& mnpair : mapMasternodes) {
+        int nType = mnpair.second.RetrieveMNType();
+        if (nType < 0 || nType >= (int)vecPaymentQueues.size()) continue;
+        vecPaymentQueues[nType].insert(std::make_pair(mnpair.second.GetLastPaidBlock(), mnpair.first));
+    }
+
+    fPaymentQueuesDirty = false;
+}
+
 void CMasternodeMan::UpdateLastPaid(const CBlockIndex* pindex)
 {
     LOCK2(cs_main, cs);
@@ -1456,7 +1606,16 @@ void CMasternodeMan::UpdateLastPaid(const CBlockIndex* pindex)
     //                         nCachedBlockHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
     for (auto& mnpair: mapMasternodes) {
+        int nBlockLastPaidPrev = mnpair.second.GetLastPaidBlock();
         mnpair.second.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
+        if (mnpair.second.GetLastPaidBlock() == nBlockLastPaidPrev) continue;
+        fSnapshotDirty = true;
+        if (fPaymentQueuesDirty) continue;
+        // move the masternode to its new place in the payment queue
+        int nType = mnpair.second.RetrieveMNType();
+        if (nType < 0 || nType >= (int)vecPaymentQueues.size()) continue;
+        vecPaymentQueues[nType].erase(std::make_pair(nBlockLastPaidPrev, mnpair.first));
+        vecPaymentQueues[nType].insert(std::make_pair(mnpair.second.GetLastPaidBlock(), mnpair.first));
     }
 
     IsFirstRun = false;
@@ -1486,6 +1645,7 @@ void CMasternodeMan::CheckMasternode(const CPubKey& pubKeyMasternode, bool fForc
     for (auto& mnpair : mapMasternodes) {
         if (mnpair.second.pubKeyMasternode == pubKeyMasternode) {
             mnpair.second.Check(fForce);
+            fSnapshotDirty = true;
             return;
         }
     }
@@ -1494,8 +1654,8 @@ void CMasternodeMan::CheckMasternode(const CPubKey& pubKeyMasternode, bool fForc
 bool CMasternodeMan::IsMasternodePingedWithin(const COutPoint& outpoint, int nSeconds, int64_t nTimeToCheckAt)
 {
     LOCK(cs);
-    CMasternode* pmn = Find(outpoint);
-    return pmn ? pmn->IsPingedWithin(nSeconds, nTimeToCheckAt) : false;
+    auto it = mapMasternodes.find(outpoint);
+    return it != mapMasternodes.end() ? it->second.IsPingedWithin(nSeconds, nTimeToCheckAt) : false;
 }
 
 void CMasternodeMan::SetMasternodeLastPing(const COutPoint& outpoint, const CMasternodePing& mnp)
@@ -1514,8 +1674,7 @@ void CMasternodeMan::SetMasternodeLastPing(const COutPoint& outpoint, const CMas
     }
     mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
 
-    CMasternodeBroadcast mnb(*pmn);
-    uint256 hash = mnb.GetHash();
+    uint256 hash = pmn->GetBroadcastHash();
     if(mapSeenMasternodeBroadcast.count(hash)) {
         mapSeenMasternodeBroadcast[hash].second.lastPing = mnp;
     }
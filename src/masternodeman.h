@@ -8,6 +8,10 @@
 #include <masternode.h>
 #include <sync.h>
 
+#include <memory>
+#include <queue>
+#include <unordered_map>
+
 using namespace std;
 
 class CMasternodeMan;
@@ -22,6 +26,14 @@ public:
     typedef std::vector<score_pair_t> score_pair_vec_t;
     typedef std::pair<int, CMasternode> rank_pair_t;
     typedef std::vector<rank_pair_t> rank_pair_vec_t;
+    typedef std::set<std::pair<int, COutPoint> > payment_queue_t;
+    typedef std::pair<int64_t, COutPoint> check_deadline_t;
+
+    /// Read-only copy of the masternode list, see GetSnapshot()
+    struct snapshot_t {
+        std::map<COutPoint, masternode_info_t> mapInfo;
+        std::map<CPubKey, COutPoint> mapByPubKeyMasternode;
+    };
 
 private:
     static const std::string SERIALIZATION_VERSION_STRING;
@@ -41,6 +53,14 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const int RANK_CACHE_MAX_ENTRIES     = 32;
+
+    /// Masternode ranks for one block, best first
+    struct rank_cache_entry_t {
+        uint256 nBlockHash;
+        std::vector<COutPoint> vecOutpoints;
+        std::unordered_map<COutPoint, int, SaltedOutpointHasher> mapRanks;
+    };
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -74,11 +94,48 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // ranks keyed by (block height, min protocol), dropped whenever the list changes
+    std::map<std::pair<int, int>, rank_cache_entry_t> mapRankCache;
+
+    // masternodes of each collateral tier ordered by last paid block, oldest first
+    std::vector<payment_queue_t> vecPaymentQueues;
+    // set when masternodes were added or removed or their collateral changed
+    bool fPaymentQueuesDirty;
+
+    // masternodes by the time their next check is due, earliest first,
+    // entries that don't match mapCheckDeadlines are outdated and skipped
+    std::priority_queue<check_deadline_t, std::vector<check_deadline_t>, std::greater<check_deadline_t> > queueCheckDeadlines;
+    std::map<COutPoint, int64_t> mapCheckDeadlines;
+    // set when the list was replaced and all deadlines have to be rebuilt
+    bool fCheckDeadlinesDirty;
+
+    // protects the snapshot pointer only, never held while doing anything else
+    mutable CCriticalSection cs_snapshot;
+    // last published copy of the list, readers use it without taking cs
+    std::shared_ptr<const snapshot_t> snapshot;
+    // set when entries were changed in place after the last publish,
+    // Check() publishes them on its next run
+    bool fSnapshotDirty;
+
     friend class CMasternodeSync;
+    friend struct CMasternodeManTest;
     /// Find an entry
     CMasternode* Find(const COutPoint& outpoint);
 
     bool GetMasternodeScores(const uint256& nBlockHash, score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol = 0);
+    /// Ranks for the given block, computed on first use
+    const rank_cache_entry_t* GetRankCacheEntry(int nBlockHeight, const uint256& nBlockHash, int nMinProtocol);
+    /// Must be called whenever masternodes are added, removed or change their protocol version
+    void InvalidateRankCache() { mapRankCache.clear(); }
+    void RebuildPaymentQueues();
+
+    /// Check the masternode again at nTime, requires cs
+    void ScheduleCheck(const COutPoint& outpoint, int64_t nTime);
+
+    /// Copy the list into a new snapshot, requires cs
+    void PublishSnapshot();
+    /// Last published snapshot, never takes cs
+    std::shared_ptr<const snapshot_t> GetSnapshot() const;
 
 public:
     // Keep track of all broadcasts I've seen
@@ -116,8 +173,14 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
-        if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
-            Clear();
+        if(ser_action.ForRead()) {
+            InvalidateRankCache();
+            fPaymentQueuesDirty = true;
+            fCheckDeadlinesDirty = true;
+            if(strVersion != SERIALIZATION_VERSION_STRING) {
+                Clear();
+            }
+            PublishSnapshot();
         }
     }
 
@@ -134,7 +197,7 @@ public:
     bool AllowMixing(const COutPoint &outpoint);
     bool DisallowMixing(const COutPoint &outpoint);
 
-    /// Check all Masternodes
+    /// Check the Masternodes whose next check is due
     void Check();
 
     /// Check all Masternodes and remove inactive
@@ -164,8 +227,11 @@ public:
     bool GetMasternodeInfo(const COutPoint& outpoint, masternode_info_t& mnInfoRet);
     bool GetMasternodeInfo(const CPubKey& pubKeyMasternode, masternode_info_t& mnInfoRet);
     bool GetMasternodeInfo(const CScript& payee, masternode_info_t& mnInfoRet);
+    /// Collateral level of a masternode, -1 if it is unknown or its collateral is not valid
+    int GetMasternodeTier(const COutPoint& outpoint);
 
-    /// Find an entry in the masternode list that is next to be paid
+    /// Find an entry in the masternode list that is next to be paid.
+    /// Only the masternodes at the head of the tier's payment queue are scored, nCountRet is how many of them were eligible.
     bool GetNextMasternodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCountRet, masternode_info_t& mnInfoRet, int mnType);
     /// Same as above but use current block height
     bool GetNextMasternodeInQueueForPayment(bool fFilterSigTime, int& nCountRet, masternode_info_t& mnInfoRet) const;
@@ -203,6 +269,9 @@ public:
 
     void UpdateLastPaid(const CBlockIndex* pindex);
 
+    /// Forget the cached collateral of masternodes whose outpoint is spent or created by this block
+    void UpdateCollaterals(const CBlock& block);
+
     void AddDirtyGovernanceObjectHash(const uint256& nHash)
     {
         LOCK(cs);
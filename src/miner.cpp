@@ -112,7 +112,7 @@ void BlockAssembler::resetBlock()
     nFees = 0;
 }
 
-std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(CWallet *wallet, const CScript &scriptPubKeyIn, bool fProofOfStake, bool fMineWitnessTx)
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(CWallet *wallet, const CScript &scriptPubKeyIn, bool fProofOfStake, bool fMineWitnessTx, int64_t nStakeSearchFrom, bool* pfStakeSearched)
 {
     int64_t nTimeStart = GetTimeMicros();
 
@@ -179,14 +179,18 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(CWallet *wallet,
     if(fProofOfStake) {
         assert(wallet);
         boost::this_thread::interruption_point();
-        pblock->nBits = GetNextWorkRequired(pindexPrev, chainparams.GetConsensus(), fProofOfStake);
+        {
+            // the next work is cached on pindexPrev under cs_main
+            LOCK(cs_main);
+            pblock->nBits = GetNextWorkRequired(pindexPrev, chainparams.GetConsensus(), fProofOfStake);
+        }
         CMutableTransaction coinstakeTx;
         int64_t nSearchTime = pblock->nTime; // search to current time
         bool fStakeFound = false;
 
         if (nSearchTime >= nLastCoinStakeSearchTime) {
             unsigned int nTxNewTime = 0;
-            if ( wallet->GetBalance() > 0 && wallet->CreateCoinStake(*wallet, pblock->nBits, refBlockReward, coinstakeTx, nTxNewTime, vwtxPrev, fIncludeWitness))
+            if ( wallet->GetBalance() > 0 && wallet->CreateCoinStake(*wallet, pblock->nBits, refBlockReward, coinstakeTx, nTxNewTime, vwtxPrev, fIncludeWitness, nStakeSearchFrom, pfStakeSearched))
             {
                 pblock->nTime = nTxNewTime;
                 coinbaseTx.vout[0].SetEmpty();
@@ -213,9 +217,15 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(CWallet *wallet,
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
+    const size_t nSelectionBegin = pblock->vtx.size();
+    unsigned int nTransactionsUpdated;
+    bool fSelectionChanged;
     {
         LOCK(mempool.cs);
-        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+        nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        fSelectionChanged = !AddPreviousSelection(pindexPrev) || nTransactionsUpdated != nSelectedTransactionsUpdated;
+        if (fSelectionChanged)
+            addPackageTxs(nPackagesSelected, nDescendantsUpdated);
     }
 
     coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
@@ -227,7 +237,10 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(CWallet *wallet,
     pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
     if(!fProofOfStake)
         UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
-    pblock->nBits          = GetNextWorkRequired(pindexPrev, chainparams.GetConsensus(), fProofOfStake);
+    {
+        LOCK(cs_main);
+        pblock->nBits      = GetNextWorkRequired(pindexPrev, chainparams.GetConsensus(), fProofOfStake);
+    }
     pblock->nNonce         = 0;
     pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
 
@@ -237,7 +250,13 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(CWallet *wallet,
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    pindexSelected = pindexPrev;
+    nSelectedTransactionsUpdated = nTransactionsUpdated;
+    nSelectedLockTimeCutoff = nLockTimeCutoff;
+    fSelectedIncludeWitness = fIncludeWitness;
+    vSelectedTx.assign(pblock->vtx.begin() + nSelectionBegin, pblock->vtx.end());
+
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants%s), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, fSelectionChanged ? "" : ", selection reused", 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
@@ -299,6 +318,45 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     }
 }
 
+bool BlockAssembler::AddPreviousSelection(const CBlockIndex* pindexPrev)
+{
+    if (pindexPrev != pindexSelected || nLockTimeCutoff != nSelectedLockTimeCutoff || fIncludeWitness != fSelectedIncludeWitness)
+        return false;
+
+    std::vector<CTxMemPool::txiter> vEntries;
+    CTxMemPool::setEntries setSelected;
+    vEntries.reserve(vSelectedTx.size());
+    for (const CTransactionRef& tx : vSelectedTx) {
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        // Evicted, replaced or conflicted, start over
+        if (it == mempool.mapTx.end())
+            return false;
+        vEntries.push_back(it);
+        setSelected.insert(it);
+    }
+
+    // A package that entered the mempool since and pays a better ancestor
+    // feerate than the cheapest selected transaction might have to replace
+    // it in a full block, so select everything again
+    CompareTxMemPoolEntryByAncestorFee compare;
+    CTxMemPool::txiter itCheapest = mempool.mapTx.end();
+    for (CTxMemPool::txiter it : vEntries) {
+        if (itCheapest == mempool.mapTx.end() || compare(*itCheapest, *it))
+            itCheapest = it;
+    }
+    if (itCheapest != mempool.mapTx.end()) {
+        for (auto mi = mempool.mapTx.get<ancestor_score>().begin(); mi != mempool.mapTx.get<ancestor_score>().end() && compare(*mi, *itCheapest); ++mi) {
+            if (!setSelected.count(mempool.mapTx.project<0>(mi)))
+                return false;
+        }
+    }
+
+    // Parents come first in the previous template, so the order still holds
+    for (CTxMemPool::txiter it : vEntries)
+        AddToBlock(it);
+    return true;
+}
+
 int BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
                                            indexed_modified_transaction_set &mapModifiedTx)
 {
@@ -492,6 +550,18 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     }
 }
 
+/** Put nExtraNonce into the coinbase of pblock */
+static void SetExtraNonce(CBlock *pblock, const CBlockIndex* pindexPrev, unsigned int nExtraNonce)
+{
+    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
+    CMutableTransaction txCoinbase(*pblock->vtx[0]);
+    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
+    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+
+    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+}
+
 void IncrementExtraNonce(CBlock *pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -502,13 +572,7 @@ void IncrementExtraNonce(CBlock *pblock, const CBlockIndex* pindexPrev, unsigned
         hashPrevBlock = pblock->hashPrevBlock;
     }
     ++nExtraNonce;
-    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
-    CMutableTransaction txCoinbase(*pblock->vtx[0]);
-    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
-    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
-
-    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
-    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+    SetExtraNonce(pblock, pindexPrev, nExtraNonce);
 }
 
 static bool ProcessBlockFound(const std::shared_ptr<const CBlock> &pblock, const CChainParams& chainparams)
@@ -534,27 +598,141 @@ static bool ProcessBlockFound(const std::shared_ptr<const CBlock> &pblock, const
     return true;
 }
 
-void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWallet* pwallet, bool fProofOfStake)
+//! Seconds after which a template is rebuilt to pick up new mempool transactions
+static const int64_t MINER_TEMPLATE_REFRESH = 60;
+//! Seconds over which the hash rate of the miner threads is measured
+static const int64_t MINER_HASHRATE_INTERVAL = 10;
+
+static CCriticalSection cs_minerHashRate;
+//! Hashes done since nMinerHashRateStart
+static uint64_t nMinerHashes = 0;
+static int64_t nMinerHashRateStart = 0;
+static double dMinerHashesPerSec = 0;
+
+static void ResetMinerHashRate()
 {
-    SetThreadPriority(THREAD_PRIORITY_LOWEST);
-    RenameThread("5g-miner");
+    LOCK(cs_minerHashRate);
+    nMinerHashes = 0;
+    nMinerHashRateStart = GetTimeMillis();
+    dMinerHashesPerSec = 0;
+}
 
-    unsigned int nExtraNonce = 0;
+static void AddMinerHashes(uint64_t nHashes)
+{
+    LOCK(cs_minerHashRate);
+    const int64_t nNow = GetTimeMillis();
+    nMinerHashes += nHashes;
+    if (nNow - nMinerHashRateStart >= MINER_HASHRATE_INTERVAL * 1000) {
+        dMinerHashesPerSec = 1000.0 * nMinerHashes / (nNow - nMinerHashRateStart);
+        nMinerHashes = 0;
+        nMinerHashRateStart = nNow;
+    }
+}
 
-    std::shared_ptr<CReserveScript> coinbaseScript;
+double GetMinerHashRate()
+{
+    LOCK(cs_minerHashRate);
+    return dMinerHashesPerSec;
+}
+
+MinerCoordinator::MinerCoordinator(const CChainParams& chainparamsIn, CWallet* pwalletIn, int nSlicesIn) :
+    chainparams(chainparamsIn), pwallet(pwalletIn),
+    nSlices(std::max(1, std::min(nSlicesIn, 1 << 16))),
+    nSliceSize(((uint64_t(1) << 32) / nSlices) & ~uint64_t(0xFF)),
+    assembler(chainparamsIn)
+{
     pwallet->GetScriptForMining(coinbaseScript);
+}
+
+bool MinerCoordinator::TemplateOutdated() const
+{
+    if (!pblockTemplate)
+        return true;
+    {
+        LOCK(cs_main);
+        if (pindexPrev != chainActive.Tip())
+            return true;
+    }
+    return mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nTemplateTime > MINER_TEMPLATE_REFRESH;
+}
+
+bool MinerCoordinator::GetWork(MinerWork& work)
+{
+    LOCK(cs);
+    if (TemplateOutdated()) {
+        // Throw an error if no script was provided.  This can happen
+        // due to some internal error but also if the keypool is empty.
+        // In the latter case, already the pointer is NULL.
+        if (!coinbaseScript || coinbaseScript->reserveScript.empty())
+            throw std::runtime_error("No coinbase script available (mining requires a wallet)");
+
+        pblockTemplate.reset();
+        unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        auto pblocktemplate = assembler.CreateNewBlock(pwallet, coinbaseScript->reserveScript, false, true);
+        if (!pblocktemplate)
+            return false;
+        {
+            LOCK(cs_main);
+            pindexPrev = LookupBlockIndex(pblocktemplate->block.hashPrevBlock);
+        }
+        nTransactionsUpdatedLast = nTransactionsUpdated;
+        nTemplateTime = GetTime();
+        nTemplate++;
+        pblockTemplate = std::make_shared<const CBlock>(pblocktemplate->block);
+        nExtraNonce = 0;
+        nNextSlice = nSlices;
+
+        LogPrintf("5GMiner -- Running miner with %u transactions in block (%u bytes)\n", pblockTemplate->vtx.size(),
+                  ::GetSerializeSize(*pblockTemplate, SER_NETWORK, PROTOCOL_VERSION));
+    }
+
+    if (nNextSlice == nSlices) {
+        auto pblock = std::make_shared<CBlock>(*pblockTemplate);
+        SetExtraNonce(pblock.get(), pindexPrev, ++nExtraNonce);
+
+        // check if block is valid
+        if (nExtraNonce == 1) {
+            LOCK(cs_main);
+            CValidationState state;
+            if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+                throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+            }
+        }
+        pblockCurrent = pblock;
+        nNextSlice = 0;
+    }
+
+    work.pblock = pblockCurrent;
+    work.pindexPrev = pindexPrev;
+    work.nTemplate = nTemplate;
+    work.nNonceBegin = nNextSlice * nSliceSize;
+    work.nNonceEnd = nNextSlice + 1 == nSlices ? uint64_t(1) << 32 : work.nNonceBegin + nSliceSize;
+    nNextSlice++;
+    return true;
+}
+
+bool MinerCoordinator::IsStale(const MinerWork& work)
+{
+    LOCK(cs);
+    return work.nTemplate != nTemplate || TemplateOutdated();
+}
+
+void MinerCoordinator::BlockFound()
+{
+    LOCK(cs);
+    coinbaseScript->KeepScript();
+}
+
+void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, std::shared_ptr<MinerCoordinator> coordinator)
+{
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    RenameThread("5g-miner");
 
     while (true) {
         try {
 
             MilliSleep(25);
 
-            // Throw an error if no script was provided.  This can happen
-            // due to some internal error but also if the keypool is empty.
-            // In the latter case, already the pointer is NULL.
-            if (!coinbaseScript || coinbaseScript->reserveScript.empty())
-                throw std::runtime_error("No coinbase script available (mining requires a wallet)");
-
             do {
                 if (!chainparams.MiningRequiresPeers())
                     break;
@@ -564,109 +742,73 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
                 MilliSleep(1000);
             } while (true);
 
-            if(fProofOfStake)
-            {
-                if (chainActive.Tip()->nHeight+1 < chainparams.GetConsensus().nFirstPoSBlock ||
-                    pwallet->IsLocked() || !masternodeSync.IsSynced())
-                {
-                    nLastCoinStakeSearchInterval = 0;
-                    MilliSleep(5000);
-                    continue;
-                }
-            }
-
             //
-            // Create new block
+            // Get a slice of the shared block
             //
-            unsigned int nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-            CBlockIndex* pindexPrev = chainActive.Tip();
-            if(!pindexPrev) break;
-
-            BlockAssembler assemlber(chainparams);
-            auto pblocktemplate = assemlber.CreateNewBlock(pwallet, coinbaseScript->reserveScript, fProofOfStake, true);
-            if (!pblocktemplate.get())
+            MinerWork work;
+            if (!coordinator->GetWork(work))
             {
-                LogPrintf("5gminer -- Failed to find a coinstake\n");
+                LogPrintf("5gminer -- Failed to create a block template\n");
                 MilliSleep(5000);
                 continue;
             }
-            auto pblock = std::make_shared<CBlock>(pblocktemplate->block);
-            IncrementExtraNonce(pblock.get(), pindexPrev, nExtraNonce);
-
-            LogPrintf("5GMiner -- Running miner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
-                      ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
-
-            //Sign block
-            if (fProofOfStake)
-            {
-                LogPrintf("CPUMiner : proof-of-stake block found %s \n", pblock->GetHash().ToString().c_str());
-
-                if (!SignBlock(*pblock, *pwallet)) {
-                    LogPrintf("5GMiner(): Signing new block failed \n");
-                    throw std::runtime_error(strprintf("%s: SignBlock failed", __func__));
-                }
-
-                LogPrintf("CPUMiner : proof-of-stake block was signed %s \n", pblock->GetHash().ToString().c_str());
-            }
-
-            // check if block is valid
-            CValidationState state;
-            if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
-                throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
-            }
-
-            // process proof of stake block
-            if(fProofOfStake) {
-                SetThreadPriority(THREAD_PRIORITY_NORMAL);
-                ProcessBlockFound(pblock, chainparams);
-                SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                MilliSleep(10000);
-                continue;
-            }
 
             //
             // Search
             //
-            int64_t nStart = GetTime();
-            arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
-            while (true)
+            CBlockHeader header = *work.pblock;
+            arith_uint256 hashTarget = arith_uint256().SetCompact(header.nBits);
+            // Every nonce of the template goes through the same algorithms
+            int vOrder[X16R_ALGOS];
+            GetHashSelections(header.hashPrevBlock, vOrder);
+            X16RPlan plan(vOrder);
+            uint64_t nNonce = work.nNonceBegin;
+            while (nNonce < work.nNonceEnd)
             {
-                unsigned int nHashesDone = 0;
-
-                uint256 hash;
-                while (true)
+                // Hash X16R_LANES nonces at a time, slices are aligned to 256 nonces
+                unsigned char vHeaders[X16R_LANES][80];
+                uint256 vHashes[X16R_LANES];
+                for (size_t i = 0; i < X16R_LANES; i++)
+                    memcpy(vHeaders[i], BEGIN(header.nVersion), 80);
+
+                const uint64_t nRoundBegin = nNonce;
+                bool fFound = false;
+                for (; nNonce < nRoundBegin + 0x100 && !fFound; nNonce += X16R_LANES)
                 {
-                    hash = pblock->GetPoWHash();
-                    if (UintToArith256(hash) <= hashTarget)
-                    {
-                        // Found a solution
-                        SetThreadPriority(THREAD_PRIORITY_NORMAL);
-                        LogPrintf("5gminer:\n  proof-of-work found\n  hash: %s\n  target: %s\n", hash.GetHex(), hashTarget.GetHex());
-                        ProcessBlockFound(pblock, chainparams);
-                        SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                        coinbaseScript->KeepScript();
-                        break;
+                    for (size_t i = 0; i < X16R_LANES; i++)
+                        WriteLE32(vHeaders[i] + 76, (uint32_t)(nNonce + i));
+                    HashX16RBatch(plan, vHeaders[0], 80, X16R_LANES, vHashes);
+
+                    for (size_t i = 0; i < X16R_LANES; i++) {
+                        if (UintToArith256(vHashes[i]) <= hashTarget)
+                        {
+                            // Found a solution
+                            auto pblock = std::make_shared<CBlock>(*work.pblock);
+                            pblock->nTime = header.nTime;
+                            pblock->nNonce = nNonce + i;
+                            SetThreadPriority(THREAD_PRIORITY_NORMAL);
+                            LogPrintf("5gminer:\n  proof-of-work found\n  hash: %s\n  target: %s\n", vHashes[i].GetHex(), hashTarget.GetHex());
+                            ProcessBlockFound(pblock, chainparams);
+                            SetThreadPriority(THREAD_PRIORITY_LOWEST);
+                            coordinator->BlockFound();
+                            fFound = true;
+                            break;
+                        }
                     }
-                    pblock->nNonce += 1;
-                    nHashesDone += 1;
-                    if ((pblock->nNonce & 0xFF) == 0)
-                        break;
                 }
+                AddMinerHashes(nNonce - nRoundBegin);
+                if (fFound)
+                    break;
 
                 // Check for stop or if block needs to be rebuilt
                 boost::this_thread::interruption_point();
-                // Regtest mode doesn't require peers
-                if (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0)
-                    break;
-                if (pblock->nNonce >= 0xffff0000)
+                if (chainparams.MiningRequiresPeers() && connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0)
                     break;
-                if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
-                    break;
-                if (pindexPrev != chainActive.Tip())
+                if (coordinator->IsStale(work))
                     break;
 
                 // Update nTime every few seconds
-                if (UpdateTime(pblock.get(), chainparams.GetConsensus(), pindexPrev) < 0)
+                if (UpdateTime(&header, chainparams.GetConsensus(), work.pindexPrev) < 0)
                     break;
             }
         }
@@ -683,6 +825,175 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
     }
 }
 
+//! Seconds between checks whether the wallet may stake while it may not
+static const int64_t STAKE_MINTER_IDLE_INTERVAL = 5;
+
+static CCriticalSection cs_stakeMinterStats;
+static StakeMinterStats stakeMinterStats;
+
+StakeMinterStats GetStakeMinterStats()
+{
+    LOCK(cs_stakeMinterStats);
+    return stakeMinterStats;
+}
+
+void StakeMinterNotifier::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fTipChanged = true;
+        nTimeTipChanged = GetTimeMicros();
+    }
+    cond.notify_all();
+}
+
+bool StakeMinterNotifier::Wait(int64_t nTime, int64_t& nTimeTipChangedOut)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (!fTipChanged) {
+        const int64_t nWait = nTime - GetAdjustedTime();
+        if (nWait <= 0)
+            break;
+        // wake up right at the start of the second, when the timestamp becomes valid
+        cond.wait_for(lock, boost::chrono::milliseconds(std::max<int64_t>(1, nWait * 1000 - GetTimeMillis() % 1000)));
+    }
+    const bool fChanged = fTipChanged;
+    fTipChanged = false;
+    nTimeTipChangedOut = nTimeTipChanged;
+    if (fChanged) {
+        LOCK(cs_stakeMinterStats);
+        stakeMinterStats.nTipWakeups++;
+    }
+    return fChanged;
+}
+
+static bool MayStake(const CChainParams& chainparams, CConnman& connman, CWallet* pwallet, const CBlockIndex* pindexPrev)
+{
+    if (chainparams.MiningRequiresPeers() &&
+            (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 || IsInitialBlockDownload()))
+        return false;
+
+    return pindexPrev->nHeight + 1 >= chainparams.GetConsensus().nFirstPoSBlock &&
+        !pwallet->IsLocked() && masternodeSync.IsSynced();
+}
+
+static void StakeMinter(const CChainParams& chainparams, CConnman& connman, CWallet* pwallet)
+{
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    RenameThread("5g-staker");
+
+    unsigned int nExtraNonce = 0;
+
+    std::shared_ptr<CReserveScript> coinbaseScript;
+    pwallet->GetScriptForMining(coinbaseScript);
+    if (!coinbaseScript || coinbaseScript->reserveScript.empty())
+        throw std::runtime_error("No coinbase script available (staking requires a wallet)");
+
+    // Static, so that a notification the scheduler thread is delivering
+    // while the minter is interrupted never outlives the notifier
+    static StakeMinterNotifier notifier;
+    RegisterValidationInterface(&notifier);
+    struct Unregister {
+        StakeMinterNotifier& notifier;
+        ~Unregister() { UnregisterValidationInterface(&notifier); }
+    } unregister{notifier};
+
+    // The tip being searched and the newest timestamp searched on it
+    const CBlockIndex* pindexSearched = nullptr;
+    int64_t nSearchedTime = 0;
+    int64_t nNextSearch = 0;
+    int64_t nTimeTipChanged = 0;
+
+    while (true) {
+        notifier.Wait(nNextSearch, nTimeTipChanged);
+
+        CBlockIndex* pindexPrev;
+        {
+            LOCK(cs_main);
+            pindexPrev = chainActive.Tip();
+        }
+        if (!pindexPrev)
+            break;
+
+        if (!MayStake(chainparams, connman, pwallet, pindexPrev)) {
+            // slots passing while the wallet may not stake are not missed
+            nLastCoinStakeSearchInterval = 0;
+            pindexSearched = nullptr;
+            nNextSearch = GetAdjustedTime() + STAKE_MINTER_IDLE_INTERVAL;
+            continue;
+        }
+
+        // a block must be newer than its parent and the median time past
+        const int64_t nFirstValidTime = std::max(pindexPrev->GetMedianTimePast(), pindexPrev->GetBlockTime()) + 1;
+        const int64_t nNow = GetAdjustedTime();
+        if (nNow < nFirstValidTime) {
+            nNextSearch = nFirstValidTime;
+            continue;
+        }
+
+        if (pindexPrev != pindexSearched) {
+            pindexSearched = pindexPrev;
+            nSearchedTime = nFirstValidTime - 1;
+        }
+
+        // each search hashes the timestamps of the hash drift window that
+        // the previous search on this tip did not reach, the wallet searches
+        // the whole window of coins that could not stake back then
+        const int64_t nWindowStart = nNow - pwallet->GetHashDrift();
+        const int64_t nSearchFrom = std::max(nSearchedTime, nWindowStart);
+        // the next timestamp
+        nNextSearch = nNow + 1;
+
+        try {
+            BlockAssembler assembler(chainparams);
+            bool fSearched = false;
+            auto pblocktemplate = assembler.CreateNewBlock(pwallet, coinbaseScript->reserveScript, true, true, nSearchFrom, &fSearched);
+            if (fSearched) {
+                LOCK(cs_stakeMinterStats);
+                if (nSearchedTime == nFirstValidTime - 1)
+                    stakeMinterStats.nLastTipLatency = nTimeTipChanged ? GetTimeMicros() - nTimeTipChanged : 0;
+                stakeMinterStats.nSearches++;
+                stakeMinterStats.nSlotsSearched += nNow - nSearchFrom;
+                if (nWindowStart > nSearchedTime)
+                    stakeMinterStats.nSlotsMissed += nWindowStart - nSearchedTime;
+                nSearchedTime = nNow;
+            }
+            if (!pblocktemplate)
+                continue;
+
+            {
+                LOCK(cs_stakeMinterStats);
+                stakeMinterStats.nStakesFound++;
+            }
+
+            auto pblock = std::make_shared<CBlock>(pblocktemplate->block);
+            IncrementExtraNonce(pblock.get(), pindexPrev, nExtraNonce);
+
+            LogPrintf("%s: proof-of-stake block found %s with %u transactions\n", __func__,
+                      pblock->GetHash().ToString(), pblock->vtx.size());
+
+            if (!SignBlock(*pblock, *pwallet))
+                throw std::runtime_error(strprintf("%s: SignBlock failed", __func__));
+
+            {
+                LOCK(cs_main);
+                CValidationState state;
+                if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false))
+                    throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+            }
+
+            SetThreadPriority(THREAD_PRIORITY_NORMAL);
+            ProcessBlockFound(pblock, chainparams);
+            SetThreadPriority(THREAD_PRIORITY_LOWEST);
+
+            // the new tip is handled right away, no need to wait for its notification
+            nNextSearch = 0;
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: runtime error: %s\n", __func__, e.what());
+        }
+    }
+}
+
 void Generate5Gs(bool fGenerate,
                   int nThreads,
                   const CChainParams& chainparams,
@@ -700,12 +1011,16 @@ void Generate5Gs(bool fGenerate,
         minerThreads = NULL;
     }
 
+    ResetMinerHashRate();
+
     if (nThreads == 0 || !fGenerate)
         return;
 
+    // Shared by the threads, which also keeps it alive for interrupted ones
+    auto coordinator = std::make_shared<MinerCoordinator>(chainparams, GetWallets().front(), nThreads);
     minerThreads = new boost::thread_group();
     for (int i = 0; i < nThreads; i++)
-        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), boost::ref(connman), GetWallets().front(), false));
+        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), boost::ref(connman), coordinator));
 }
 
 void ThreadStakeMinter(const CChainParams &chainparams, CConnman &connman, CWallet *pwallet)
@@ -713,7 +1028,7 @@ void ThreadStakeMinter(const CChainParams &chainparams, CConnman &connman, CWall
     boost::this_thread::interruption_point();
     LogPrintf("ThreadStakeMinter started\n");
     try {
-        BitcoinMiner(chainparams, connman, pwallet, true);
+        StakeMinter(chainparams, connman, pwallet);
         boost::this_thread::interruption_point();
     } catch (std::exception& e) {
         LogPrintf("ThreadStakeMinter() exception %s\n", e.what());
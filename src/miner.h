@@ -8,16 +8,20 @@
 
 #include <primitives/block.h>
 #include <txmempool.h>
+#include <validationinterface.h>
 
 #include <stdint.h>
 #include <memory>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 class CBlockIndex;
 class CChainParams;
 class CWallet;
 class CScript;
+class CReserveScript;
 class CConnman;
 
 namespace Consensus { struct Params; };
@@ -151,6 +155,14 @@ private:
     // Stake info
     int64_t nLastCoinStakeSearchTime = 0;
 
+    // Transactions picked for the previous template, reused by the next
+    // template on the same tip
+    const CBlockIndex* pindexSelected = nullptr;
+    unsigned int nSelectedTransactionsUpdated = 0;
+    int64_t nSelectedLockTimeCutoff = 0;
+    bool fSelectedIncludeWitness = false;
+    std::vector<CTransactionRef> vSelectedTx;
+
 public:
     struct Options {
         Options();
@@ -161,12 +173,20 @@ public:
     explicit BlockAssembler(const CChainParams& params);
     BlockAssembler(const CChainParams& params, const Options& options);
 
-    /** Construct a new block template with coinbase to scriptPubKeyIn */
+    /** Construct a new block template with coinbase to scriptPubKeyIn.
+      * While the tip stays the same, further calls on the same assembler keep
+      * the previous transaction selection and only add what entered the
+      * mempool since, unless a new package pays a better feerate than part of
+      * the selection; the coinbase (or coinstake) is always built anew.
+      * A proof of stake search skips the timestamps up to nStakeSearchFrom,
+      * pfStakeSearched tells whether the kernel search ran. */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true);
     std::unique_ptr<CBlockTemplate> CreateNewBlock(CWallet *wallet,
                                                    const CScript& scriptPubKeyIn,
                                                    bool fProofOfStake,
-                                                   bool fMineWitnessTx);
+                                                   bool fMineWitnessTx,
+                                                   int64_t nStakeSearchFrom = 0,
+                                                   bool* pfStakeSearched = nullptr);
 
 
 private:
@@ -175,6 +195,10 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Add the transactions of the previous template if it was built on
+      * the same tip, all of them are still in the mempool and no package
+      * outside of it has a better ancestor feerate than the cheapest one */
+    bool AddPreviousSelection(const CBlockIndex* pindexPrev);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
@@ -207,8 +231,106 @@ private:
 void IncrementExtraNonce(CBlock *pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
+/** A slice of the nonce space of a shared block template */
+struct MinerWork
+{
+    std::shared_ptr<const CBlock> pblock;
+    const CBlockIndex* pindexPrev = nullptr;
+    uint64_t nNonceBegin = 0;
+    uint64_t nNonceEnd = 0;
+    //! Template the slice was cut from
+    uint64_t nTemplate = 0;
+};
+
+/**
+ * Builds one block template for all miner threads and splits the nonce space
+ * of each extranonce into one slice per thread, so no two threads hash the
+ * same header. Once every slice of an extranonce is handed out, the next
+ * extranonce starts a new set of slices.
+ */
+class MinerCoordinator
+{
+public:
+    MinerCoordinator(const CChainParams& chainparams, CWallet* pwallet, int nSlices);
+
+    /** Next slice to search, false if no template could be built */
+    bool GetWork(MinerWork& work);
+    /** Whether the template of work was replaced or should be */
+    bool IsStale(const MinerWork& work);
+    /** Keep the coinbase script once a block paid to it */
+    void BlockFound();
+
+private:
+    const CChainParams& chainparams;
+    CWallet* const pwallet;
+    const int nSlices;
+    //! Multiple of 256, the interval at which miner threads check for new work
+    const uint64_t nSliceSize;
+
+    CCriticalSection cs;
+    BlockAssembler assembler;
+    std::shared_ptr<CReserveScript> coinbaseScript;
+    std::shared_ptr<const CBlock> pblockTemplate;
+    CBlockIndex* pindexPrev = nullptr;
+    unsigned int nTransactionsUpdatedLast = 0;
+    int64_t nTemplateTime = 0;
+    uint64_t nTemplate = 0;
+    //! The template with the current extranonce
+    std::shared_ptr<const CBlock> pblockCurrent;
+    unsigned int nExtraNonce = 0;
+    int nNextSlice = 0;
+
+    bool TemplateOutdated() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+};
+
 /** Run the miner threads */
 void Generate5Gs(bool fGenerate, int nThreads, const CChainParams& chainparams, CConnman &connman);
+/** Hashes per second of all miner threads together */
+double GetMinerHashRate();
 void ThreadStakeMinter(const CChainParams& chainparams, CConnman &connman, CWallet *pwallet);
 
+/**
+ * Wakes the stake minter when the tip changes, so a search on the new tip
+ * starts as soon as its first valid timestamp is reached instead of after a
+ * fixed sleep.
+ */
+class StakeMinterNotifier final : public CValidationInterface
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fTipChanged = false;
+    int64_t nTimeTipChanged = 0;
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+
+public:
+    /**
+     * Wait until the adjusted time reaches nTime or the tip changes, whichever
+     * comes first. Returns whether the tip changed, and when, since the last call.
+     * This is an interruption point.
+     */
+    bool Wait(int64_t nTime, int64_t& nTimeTipChangedOut);
+};
+
+/**
+ * Counters of the stake minter. A slot is a block timestamp on the current
+ * tip; it is searched when some kernel search covered it and missed when it
+ * fell out of the wallet's hash drift window before any search did.
+ */
+struct StakeMinterStats
+{
+    uint64_t nSearches = 0;
+    uint64_t nStakesFound = 0;
+    //! Tips the minter woke up for
+    uint64_t nTipWakeups = 0;
+    uint64_t nSlotsSearched = 0;
+    uint64_t nSlotsMissed = 0;
+    //! Microseconds from the last tip change to the first search on it
+    int64_t nLastTipLatency = 0;
+};
+
+StakeMinterStats GetStakeMinterStats();
+
 #endif // BITCOIN_MINER_H
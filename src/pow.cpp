@@ -23,7 +23,7 @@ const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfSta
 unsigned int DualKGW3(const CBlockIndex* pindexLast, const Consensus::Params& params)
 {
     const CBlockIndex* BlockLastSolved = GetLastBlockIndex(pindexLast, false);
-    const CBlockIndex* BlockReading = GetLastBlockIndex(pindexLast, false);
+    const CBlockIndex* BlockReading = BlockLastSolved;
     int64_t PastBlocksMass = 0;
     int64_t PastRateActualSeconds = 0;
     int64_t PastRateTargetSeconds = 0;
@@ -155,11 +155,24 @@ unsigned int PoSWorkRequired(const CBlockIndex* pindexLast, const Consensus::Par
 
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const Consensus::Params& params, bool fProofOfStake)
 {
+    // The target only depends on pindexLast and its ancestors. DualKGW3 walks
+    // back up to a week of blocks, so remember it for the block checks, block
+    // templates and RPCs that ask for the same tip again.
+    unsigned int* pnCached = nullptr;
+    if (pindexLast) {
+        AssertLockHeld(cs_main);
+        pnCached = fProofOfStake ? &pindexLast->nNextWorkPoS : &pindexLast->nNextWorkPoW;
+        if (*pnCached)
+            return *pnCached;
+    }
+
     unsigned int nBits = 0;
     if(fProofOfStake)
         nBits = PoSWorkRequired(pindexLast, params);
     else
         nBits = DualKGW3(pindexLast, params);
+    if (pnCached)
+        *pnCached = nBits;
     return nBits;
 }
 
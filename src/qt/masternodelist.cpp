@@ -210,7 +210,7 @@ void MasternodeList::updateMyMasternodeInfo(QString strAlias, QString strAddr, c
 
     masternode_info_t infoMn;
     bool fFound = mnodeman.GetMasternodeInfo(outpoint, infoMn);        
-    std::string level = CMasternode::GetMNLevelStr(static_cast<CMasternode*>(&infoMn)->RetrieveMNType());
+    std::string level = CMasternode::GetMNLevelStr(mnodeman.GetMasternodeTier(outpoint));
 
     QTableWidgetItem *aliasItem = new QTableWidgetItem(strAlias);
     QTableWidgetItem *addrItem = new QTableWidgetItem(fFound ? QString::fromStdString(infoMn.addr.ToString()) : strAddr);
@@ -302,7 +302,7 @@ void MasternodeList::updateNodeList()
         // populate list
         // Address, Level, Protocol, Status, Active Seconds, Last Seen, Pub Key
         QTableWidgetItem *addressItem = new QTableWidgetItem(QString::fromStdString(mn.addr.ToString()));
-        QTableWidgetItem *levelItem = new QTableWidgetItem(QString::fromStdString(CMasternode::GetMNLevelStr(mn.RetrieveMNType())));
+        QTableWidgetItem *levelItem = new QTableWidgetItem(QString::fromStdString(CMasternode::GetMNLevelStr(mnodeman.GetMasternodeTier(mnpair.first))));
         levelItem->setTextAlignment(AlignHCenter | AlignVCenter);
 
         QTableWidgetItem *protocolItem = new QTableWidgetItem(QString::number(mn.nProtocolVersion));
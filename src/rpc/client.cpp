@@ -131,6 +131,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getsuperblockbudget", 0},
     { "spork", 1 },
     { "setgenerate", 1, "genproclimit" },
+    { "getx16rstats", 0, "enable" },
     { "estimatesmartfee", 0, "conf_target" },
     { "estimaterawfee", 0, "conf_target" },
     { "estimaterawfee", 1, "threshold" },
@@ -10,6 +10,7 @@
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <crypto/x16r.h>
 #include <init.h>
 #include <validation.h>
 #include <key_io.h>
@@ -201,6 +202,7 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
             "  \"currentblockweight\": nnn, (numeric) The last block weight\n"
             "  \"currentblocktx\": nnn,     (numeric) The last block transaction\n"
             "  \"difficulty\": xxx.xxxxx    (numeric) The current difficulty\n"
+            "  \"hashespersec\": nnn,       (numeric) The hashes per second of the built-in miner threads\n"
             "  \"networkhashps\": nnn,      (numeric) The network hashes per second\n"
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
             "  \"chain\": \"xxxx\",           (string) current network name as defined in BIP70 (main, test, regtest)\n"
@@ -226,6 +228,7 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
     diff.push_back(Pair("proof-of-stake",(double)nround(GetDifficulty(GetNextWorkRequired(tip,consensusParams,true)),8)));
     obj.push_back(Pair("difficulty", diff));
     obj.pushKV("difficulty", diff);
+    obj.pushKV("hashespersec",     GetMinerHashRate());
     obj.pushKV("networkhashps",    getnetworkhashps(request));
     obj.pushKV("pooledtx",         (uint64_t)mempool.size());
     obj.pushKV("chain",            Params().NetworkIDString());
@@ -233,6 +236,53 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
     return obj;
 }
 
+static UniValue getx16rstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getx16rstats ( enable )\n"
+            "\nReturns the number of inputs hashed and the time spent by each X16R algorithm.\n"
+            "Counting is off unless started with -x16rstats or by this call.\n"
+            "\nArguments:\n"
+            "1. enable         (boolean, optional) Start (true) or stop (false) counting\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,    (boolean) Whether hashes are being counted\n"
+            "  \"algorithms\": {\n"
+            "    \"name\": {              (json object) One entry per algorithm, e.g. \"blake\"\n"
+            "      \"hashes\": n,         (numeric) Number of inputs hashed\n"
+            "      \"time\": n,           (numeric) Total time spent in seconds\n"
+            "      \"nsperhash\": n       (numeric) Average nanoseconds per input\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getx16rstats", "true")
+            + HelpExampleRpc("getx16rstats", "")
+        );
+
+    if (!request.params[0].isNull())
+        X16RSetStatsEnabled(request.params[0].get_bool());
+
+    uint64_t hashes[X16R_ALGOS], nanos[X16R_ALGOS];
+    X16RGetStats(hashes, nanos);
+
+    UniValue algos(UniValue::VOBJ);
+    for (int algo = 0; algo < X16R_ALGOS; algo++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("hashes", hashes[algo]);
+        entry.pushKV("time", nanos[algo] * 1e-9);
+        entry.pushKV("nsperhash", hashes[algo] ? (double)nanos[algo] / hashes[algo] : 0.0);
+        algos.pushKV(X16RAlgoName(algo), entry);
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("enabled", X16RStatsEnabled());
+    obj.pushKV("algorithms", algos);
+    return obj;
+}
+
 
 // NOTE: Unlike wallet RPC (which use 5G values), mining RPCs follow GBT (BIP 22) in using satoshi amounts
 static UniValue prioritisetransaction(const JSONRPCRequest& request)
@@ -521,6 +571,8 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    // Reuses its transaction selection while the tip does not change
+    static std::unique_ptr<BlockAssembler> assembler;
     // Cache whether the last invocation was with segwit support, to avoid returning
     // a segwit-block to a non-segwit caller.
     static bool fLastTemplateSupportsSegwit = true;
@@ -539,7 +591,9 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
 
         // Create new block
         CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, fSupportsSegwit);
+        if (!assembler)
+            assembler.reset(new BlockAssembler(Params()));
+        pblocktemplate = assembler->CreateNewBlock(scriptDummy, fSupportsSegwit);
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
@@ -1055,6 +1109,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "mining",             "getnetworkhashps",       &getnetworkhashps,       {"nblocks","height"} },
     { "mining",             "getmininginfo",          &getmininginfo,          {} },
+    { "mining",             "getx16rstats",           &getx16rstats,           {"enable"} },
     { "mining",             "prioritisetransaction",  &prioritisetransaction,  {"txid","dummy","fee_delta"} },
     { "mining",             "getblocktemplate",       &getblocktemplate,       {"template_request"} },
     { "mining",             "submitblock",            &submitblock,            {"hexdata","dummy"} },
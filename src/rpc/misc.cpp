@@ -486,6 +486,12 @@ UniValue getstakingstatus(const JSONRPCRequest& request)
             "  \"enoughcoins\": true|false,        (boolean) if available coins are greater than reserve balance\n"
             "  \"mnsync\": true|false,             (boolean) if masternode data is synced\n"
             "  \"staking status\": true|false,     (boolean) if the wallet is staking or not\n"
+            "  \"searches\": n,                    (numeric) kernel searches run by the stake minter\n"
+            "  \"stakesfound\": n,                 (numeric) searches that found a coinstake\n"
+            "  \"tipwakeups\": n,                  (numeric) times the stake minter woke up for a new tip\n"
+            "  \"slotssearched\": n,               (numeric) block timestamps covered by a search\n"
+            "  \"slotsmissed\": n,                 (numeric) block timestamps that passed without being searched\n"
+            "  \"lasttiplatency\": n,              (numeric) milliseconds from the last new tip to the first search on it\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getstakingstatus", "") + HelpExampleRpc("getstakingstatus", ""));
@@ -509,6 +515,14 @@ UniValue getstakingstatus(const JSONRPCRequest& request)
 
     obj.push_back(Pair("staking status", nStaking));
 
+    const StakeMinterStats stats = GetStakeMinterStats();
+    obj.push_back(Pair("searches", stats.nSearches));
+    obj.push_back(Pair("stakesfound", stats.nStakesFound));
+    obj.push_back(Pair("tipwakeups", stats.nTipWakeups));
+    obj.push_back(Pair("slotssearched", stats.nSlotsSearched));
+    obj.push_back(Pair("slotsmissed", stats.nSlotsMissed));
+    obj.push_back(Pair("lasttiplatency", stats.nLastTipLatency / 1000));
+
     return obj;
 }
 
@@ -0,0 +1,625 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <stratum.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <hash.h>
+#include <key_io.h>
+#include <miner.h>
+#include <netbase.h>
+#include <pow.h>
+#include <rpc/blockchain.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <timedata.h>
+#include <txmempool.h>
+#include <ui_interface.h>
+#include <util.h>
+#include <utilstrencodings.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <map>
+#include <memory>
+#include <set>
+
+#include <univalue.h>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <event2/thread.h>
+#include <event2/util.h>
+
+/** Seconds between template refreshes while the mempool changes */
+static const int STRATUM_REFRESH_INTERVAL = 30;
+/** Number of jobs of the current tip a late share may still refer to */
+static const size_t STRATUM_MAX_JOBS = 16;
+/** Sanity limit on the length of a request, stratum requests are tiny */
+static const size_t STRATUM_MAX_LINE_LENGTH = 16 * 1024;
+
+CStratumJob::CStratumJob(const CBlock& blockIn, int nHeight) : block(blockIn)
+{
+    // Height first in coinbase required for block.version=2, the miner
+    // owned extranonce follows as a single push
+    scriptSigPrefix = CScript() << nHeight;
+
+    CMutableTransaction txCoinbase(*block.vtx[0]);
+    txCoinbase.vin[0].scriptSig = (CScript(scriptSigPrefix) << std::vector<unsigned char>(STRATUM_EXTRANONCE1_SIZE + STRATUM_EXTRANONCE2_SIZE)) + COINBASE_FLAGS;
+    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+
+    // Miners hash the coinbase without witness. The scriptSig follows the
+    // version, the input count, the prevout and the script length.
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+    ss << txCoinbase;
+    size_t nOffset = 4 + GetSizeOfCompactSize(1) + 36 + GetSizeOfCompactSize(txCoinbase.vin[0].scriptSig.size()) + scriptSigPrefix.size() + 1;
+    coinb1 = HexStr(ss.begin(), ss.begin() + nOffset);
+    coinb2 = HexStr(ss.begin() + nOffset + STRATUM_EXTRANONCE1_SIZE + STRATUM_EXTRANONCE2_SIZE, ss.end());
+
+    // Collect the sibling of the coinbase on every level of the tree. The
+    // first entry of each level stands for the coinbase side and is never
+    // read, odd levels pair their last hash with itself as in ComputeMerkleRoot.
+    std::vector<uint256> vLevel;
+    vLevel.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) {
+        vLevel.push_back(tx->GetHash());
+    }
+    while (vLevel.size() > 1) {
+        merkleBranch.push_back(vLevel[1]);
+        std::vector<uint256> vNext(1);
+        for (size_t i = 2; i < vLevel.size(); i += 2) {
+            const uint256& right = vLevel[std::min(i + 1, vLevel.size() - 1)];
+            vNext.push_back(Hash(vLevel[i].begin(), vLevel[i].end(), right.begin(), right.end()));
+        }
+        vLevel.swap(vNext);
+    }
+}
+
+CBlock CStratumJob::GetBlock(const std::vector<unsigned char>& vchExtraNonce, uint32_t nTime, uint32_t nNonce) const
+{
+    assert(vchExtraNonce.size() == STRATUM_EXTRANONCE1_SIZE + STRATUM_EXTRANONCE2_SIZE);
+
+    CBlock blockOut(block);
+    CMutableTransaction txCoinbase(*block.vtx[0]);
+    txCoinbase.vin[0].scriptSig = (CScript(scriptSigPrefix) << vchExtraNonce) + COINBASE_FLAGS;
+    blockOut.vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+
+    uint256 hashMerkleRoot = blockOut.vtx[0]->GetHash();
+    for (const uint256& hash : merkleBranch) {
+        hashMerkleRoot = Hash(hashMerkleRoot.begin(), hashMerkleRoot.end(), hash.begin(), hash.end());
+    }
+    blockOut.hashMerkleRoot = hashMerkleRoot;
+    blockOut.nTime = nTime;
+    blockOut.nNonce = nNonce;
+    return blockOut;
+}
+
+/****** Helpers ********/
+
+/** Stratum sends the previous hash as eight byte swapped 32-bit words */
+static std::string PrevHashHex(const uint256& hash)
+{
+    unsigned char vch[32];
+    for (int i = 0; i < 8; i++) {
+        WriteBE32(vch + 4 * i, ReadLE32(hash.begin() + 4 * i));
+    }
+    return HexStr(vch, vch + 32);
+}
+
+/** Parse a big endian 32-bit hex number as sent in mining.submit */
+static bool ParseHexUInt32(const UniValue& value, uint32_t& n)
+{
+    if (!value.isStr() || value.get_str().empty() || value.get_str().size() > 8) {
+        return false;
+    }
+    n = 0;
+    for (char c : value.get_str()) {
+        signed char digit = HexDigit(c);
+        if (digit < 0) {
+            return false;
+        }
+        n = (n << 4) | digit;
+    }
+    return true;
+}
+
+/** Compact target for a stratum difficulty, the inverse of GetDifficulty() */
+static unsigned int DifficultyToCompact(double dDifficulty)
+{
+    int nShift = 29;
+    double dMantissa = (double)0x0000ffff / dDifficulty;
+    while (dMantissa > (double)0x007fffff) {
+        dMantissa /= 256.0;
+        nShift++;
+    }
+    while (dMantissa < (double)0x00008000 && nShift > 3) {
+        dMantissa *= 256.0;
+        nShift--;
+    }
+    return ((unsigned int)nShift << 24) | (unsigned int)dMantissa;
+}
+
+static UniValue StratumError(int code, const std::string& message)
+{
+    UniValue error(UniValue::VARR);
+    error.push_back(code);
+    error.push_back(message);
+    error.push_back(NullUniValue);
+    return error;
+}
+
+/****** Server ********/
+
+/** Serves jobs for the current tip to stratum miners and turns their
+ * solutions back into blocks. Everything except UpdatedBlockTip runs on the
+ * event thread.
+ */
+class StratumServer : public CValidationInterface
+{
+public:
+    StratumServer(struct event_base* base, const CScript& scriptPubKey, double dDifficulty);
+    ~StratumServer();
+
+    /** Start accepting miners on addr, return true on success */
+    bool Listen(const CService& addr);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+
+private:
+    struct Client {
+        std::vector<unsigned char> vchExtraNonce1;
+        bool fSubscribed = false;
+        bool fAuthorized = false;
+    };
+
+    struct Job {
+        Job(const CBlock& block, int nHeight) : job(block, nHeight) {}
+        CStratumJob job;
+        /** Target a share has to meet */
+        arith_uint256 shareTarget;
+        /** Difficulty announced with the job */
+        double dDifficulty;
+        /** Headers already submitted, to reject duplicates */
+        std::set<uint256> setSubmitted;
+    };
+
+    struct event_base* base;
+    struct evconnlistener* listener;
+    /** Fired from UpdatedBlockTip to build a clean job on the event thread */
+    struct event* tip_ev;
+    /** Periodically picks up new mempool transactions */
+    struct event* refresh_ev;
+
+    CScript scriptPubKey;
+    double dDifficulty;
+    /** Kept across jobs so that mempool refreshes reuse the selection */
+    BlockAssembler assembler;
+
+    std::map<struct bufferevent*, Client> mapClients;
+    std::map<uint32_t, std::unique_ptr<Job>> mapJobs;
+    uint32_t nJobId;
+    uint32_t nExtraNonce1;
+    unsigned int nTransactionsUpdatedLast;
+
+    /** Build a job from a fresh template and send it to all miners */
+    void NewJob(bool fClean);
+    void SendJob(struct bufferevent* bev, uint32_t nId, const Job& job, bool fClean);
+    void Send(struct bufferevent* bev, const UniValue& msg);
+    void Disconnect(struct bufferevent* bev);
+    /** Handle one request line, return false to drop the miner */
+    bool ProcessRequest(struct bufferevent* bev, Client& client, const std::string& line);
+    UniValue Submit(const Client& client, const UniValue& params, UniValue& error);
+
+    /** Libevent handlers: internal */
+    static void accept_cb(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr* addr, int socklen, void* ctx);
+    static void readcb(struct bufferevent* bev, void* ctx);
+    static void eventcb(struct bufferevent* bev, short what, void* ctx);
+    static void tip_cb(evutil_socket_t fd, short what, void* arg);
+    static void refresh_cb(evutil_socket_t fd, short what, void* arg);
+};
+
+StratumServer::StratumServer(struct event_base* _base, const CScript& _scriptPubKey, double _dDifficulty):
+    base(_base), listener(nullptr), scriptPubKey(_scriptPubKey), dDifficulty(_dDifficulty), assembler(Params()),
+    nJobId(0), nExtraNonce1(0), nTransactionsUpdatedLast(0)
+{
+    tip_ev = event_new(base, -1, 0, tip_cb, this);
+    refresh_ev = event_new(base, -1, EV_PERSIST, refresh_cb, this);
+    struct timeval time;
+    time.tv_sec = STRATUM_REFRESH_INTERVAL;
+    time.tv_usec = 0;
+    event_add(refresh_ev, &time);
+    // First job as soon as the event loop runs
+    event_active(tip_ev, EV_TIMEOUT, 0);
+}
+
+StratumServer::~StratumServer()
+{
+    for (const auto& item : mapClients) {
+        bufferevent_free(item.first);
+    }
+    if (listener) {
+        evconnlistener_free(listener);
+    }
+    event_free(tip_ev);
+    event_free(refresh_ev);
+}
+
+bool StratumServer::Listen(const CService& addr)
+{
+    struct sockaddr_storage addr_storage;
+    socklen_t addrlen = sizeof(addr_storage);
+    if (!addr.GetSockAddr((struct sockaddr*)&addr_storage, &addrlen)) {
+        return false;
+    }
+    listener = evconnlistener_new_bind(base, accept_cb, this, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1,
+                                       (struct sockaddr*)&addr_storage, addrlen);
+    return listener != nullptr;
+}
+
+void StratumServer::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    // Several tips in a row collapse into one job
+    event_active(tip_ev, EV_TIMEOUT, 0);
+}
+
+void StratumServer::NewJob(bool fClean)
+{
+    unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    try {
+        pblocktemplate = assembler.CreateNewBlock(scriptPubKey);
+    } catch (const std::exception& e) {
+        LogPrintf("stratum: Unable to create a block template: %s\n", e.what());
+        return;
+    }
+    if (!pblocktemplate) {
+        LogPrintf("stratum: Unable to create a block template\n");
+        return;
+    }
+    nTransactionsUpdatedLast = nTransactionsUpdated;
+    const CBlock& block = pblocktemplate->block;
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexPrev = LookupBlockIndex(block.hashPrevBlock);
+        assert(pindexPrev);
+        nHeight = pindexPrev->nHeight + 1;
+    }
+
+    // A job on another previous block makes every older job stale
+    if (!mapJobs.empty() && mapJobs.rbegin()->second->job.block.hashPrevBlock != block.hashPrevBlock) {
+        fClean = true;
+    }
+    if (fClean) {
+        mapJobs.clear();
+    }
+    while (mapJobs.size() >= STRATUM_MAX_JOBS) {
+        mapJobs.erase(mapJobs.begin());
+    }
+
+    std::unique_ptr<Job> job(new Job(block, nHeight));
+    job->dDifficulty = dDifficulty > 0 ? dDifficulty : GetDifficulty(block.nBits);
+    job->shareTarget.SetCompact(dDifficulty > 0 ? DifficultyToCompact(dDifficulty) : block.nBits);
+    const arith_uint256 powLimit = UintToArith256(Params().GetConsensus().powLimit);
+    if (job->shareTarget > powLimit) {
+        job->shareTarget = powLimit;
+    }
+
+    uint32_t nId = ++nJobId;
+    LogPrint(BCLog::STRATUM, "stratum: New job %x at height %d with %u transactions%s\n", nId, nHeight, block.vtx.size(), fClean ? " (clean)" : "");
+    for (const auto& item : mapClients) {
+        if (item.second.fAuthorized) {
+            SendJob(item.first, nId, *job, fClean);
+        }
+    }
+    mapJobs.emplace(nId, std::move(job));
+}
+
+void StratumServer::SendJob(struct bufferevent* bev, uint32_t nId, const Job& job, bool fClean)
+{
+    const CBlock& block = job.job.block;
+
+    if (fClean) {
+        UniValue params(UniValue::VARR);
+        params.push_back(job.dDifficulty);
+        UniValue msg(UniValue::VOBJ);
+        msg.pushKV("id", NullUniValue);
+        msg.pushKV("method", "mining.set_difficulty");
+        msg.pushKV("params", params);
+        Send(bev, msg);
+    }
+
+    UniValue branch(UniValue::VARR);
+    for (const uint256& hash : job.job.merkleBranch) {
+        branch.push_back(HexStr(hash.begin(), hash.end()));
+    }
+    UniValue params(UniValue::VARR);
+    params.push_back(strprintf("%x", nId));
+    params.push_back(PrevHashHex(block.hashPrevBlock));
+    params.push_back(job.job.coinb1);
+    params.push_back(job.job.coinb2);
+    params.push_back(branch);
+    params.push_back(strprintf("%08x", (uint32_t)block.nVersion));
+    params.push_back(strprintf("%08x", block.nBits));
+    params.push_back(strprintf("%08x", block.nTime));
+    params.push_back(fClean);
+    UniValue msg(UniValue::VOBJ);
+    msg.pushKV("id", NullUniValue);
+    msg.pushKV("method", "mining.notify");
+    msg.pushKV("params", params);
+    Send(bev, msg);
+}
+
+void StratumServer::Send(struct bufferevent* bev, const UniValue& msg)
+{
+    std::string str = msg.write() + "\n";
+    evbuffer_add(bufferevent_get_output(bev), str.data(), str.size());
+}
+
+void StratumServer::Disconnect(struct bufferevent* bev)
+{
+    LogPrint(BCLog::STRATUM, "stratum: Miner disconnected\n");
+    mapClients.erase(bev);
+    bufferevent_free(bev);
+}
+
+bool StratumServer::ProcessRequest(struct bufferevent* bev, Client& client, const std::string& line)
+{
+    UniValue request;
+    if (!request.read(line) || !request.isObject()) {
+        return false;
+    }
+    const UniValue& method = find_value(request, "method");
+    const UniValue& params = find_value(request, "params");
+    if (!method.isStr()) {
+        return false;
+    }
+
+    UniValue result;
+    UniValue error;
+    bool fSendJob = false;
+    if (method.get_str() == "mining.subscribe") {
+        std::string strSubscription = HexStr(client.vchExtraNonce1);
+        UniValue subscriptions(UniValue::VARR);
+        for (const char* name : {"mining.set_difficulty", "mining.notify"}) {
+            UniValue subscription(UniValue::VARR);
+            subscription.push_back(name);
+            subscription.push_back(strSubscription);
+            subscriptions.push_back(subscription);
+        }
+        result = UniValue(UniValue::VARR);
+        result.push_back(subscriptions);
+        result.push_back(HexStr(client.vchExtraNonce1));
+        result.push_back((int)STRATUM_EXTRANONCE2_SIZE);
+        client.fSubscribed = true;
+    } else if (method.get_str() == "mining.authorize") {
+        // The payout goes to -stratumaddress, any worker name is fine
+        if (!client.fSubscribed) {
+            error = StratumError(25, "Not subscribed");
+        } else {
+            result = true;
+            fSendJob = !client.fAuthorized;
+            client.fAuthorized = true;
+        }
+    } else if (method.get_str() == "mining.submit") {
+        result = Submit(client, params, error);
+    } else {
+        error = StratumError(20, "Method not found");
+    }
+
+    UniValue reply(UniValue::VOBJ);
+    reply.pushKV("id", find_value(request, "id"));
+    reply.pushKV("result", result);
+    reply.pushKV("error", error);
+    Send(bev, reply);
+
+    if (fSendJob && !mapJobs.empty()) {
+        SendJob(bev, mapJobs.rbegin()->first, *mapJobs.rbegin()->second, true);
+    }
+    return true;
+}
+
+UniValue StratumServer::Submit(const Client& client, const UniValue& params, UniValue& error)
+{
+    if (!client.fAuthorized) {
+        error = StratumError(24, "Unauthorized worker");
+        return NullUniValue;
+    }
+
+    // [worker, job id, extranonce2, ntime, nonce]
+    uint32_t nId, nTime, nNonce;
+    if (!params.isArray() || params.size() < 5 || !params[2].isStr() ||
+        !ParseHexUInt32(params[1], nId) || !ParseHexUInt32(params[3], nTime) || !ParseHexUInt32(params[4], nNonce)) {
+        error = StratumError(20, "Invalid parameters");
+        return NullUniValue;
+    }
+    const std::string& strExtraNonce2 = params[2].get_str();
+    if (strExtraNonce2.size() != 2 * STRATUM_EXTRANONCE2_SIZE || !IsHex(strExtraNonce2)) {
+        error = StratumError(20, "Invalid extranonce2");
+        return NullUniValue;
+    }
+    auto it = mapJobs.find(nId);
+    if (it == mapJobs.end()) {
+        error = StratumError(21, "Job not found");
+        return NullUniValue;
+    }
+    Job& job = *it->second;
+    if (nTime < job.job.block.nTime || nTime > GetAdjustedTime() + MAX_FUTURE_BLOCK_TIME) {
+        error = StratumError(20, "ntime out of range");
+        return NullUniValue;
+    }
+
+    std::vector<unsigned char> vchExtraNonce(client.vchExtraNonce1);
+    std::vector<unsigned char> vchExtraNonce2 = ParseHex(strExtraNonce2);
+    vchExtraNonce.insert(vchExtraNonce.end(), vchExtraNonce2.begin(), vchExtraNonce2.end());
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>(job.job.GetBlock(vchExtraNonce, nTime, nNonce));
+
+    if (!job.setSubmitted.insert(pblock->GetHash()).second) {
+        error = StratumError(22, "Duplicate share");
+        return NullUniValue;
+    }
+
+    uint256 hash = pblock->GetPoWHash();
+    if (CheckProofOfWork(hash, pblock->nBits, true, Params().GetConsensus())) {
+        LogPrintf("stratum: Block %s found by a miner\n", pblock->GetHash().ToString());
+        bool fNewBlock = false;
+        if (!ProcessNewBlock(Params(), pblock, true, &fNewBlock) || !fNewBlock) {
+            error = StratumError(20, "Block rejected");
+            return NullUniValue;
+        }
+        return true;
+    }
+    if (UintToArith256(hash) > job.shareTarget) {
+        error = StratumError(23, "Low difficulty share");
+        return NullUniValue;
+    }
+    return true;
+}
+
+void StratumServer::accept_cb(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr* addr, int socklen, void* ctx)
+{
+    StratumServer* self = static_cast<StratumServer*>(ctx);
+    struct bufferevent* bev = bufferevent_socket_new(self->base, fd, BEV_OPT_CLOSE_ON_FREE);
+    if (!bev) {
+        evutil_closesocket(fd);
+        return;
+    }
+    Client& client = self->mapClients[bev];
+    client.vchExtraNonce1.resize(STRATUM_EXTRANONCE1_SIZE);
+    WriteBE32(client.vchExtraNonce1.data(), ++self->nExtraNonce1);
+
+    bufferevent_setcb(bev, StratumServer::readcb, nullptr, StratumServer::eventcb, self);
+    bufferevent_enable(bev, EV_READ|EV_WRITE);
+    LogPrint(BCLog::STRATUM, "stratum: Miner connected, extranonce1 %s\n", HexStr(client.vchExtraNonce1));
+}
+
+void StratumServer::readcb(struct bufferevent* bev, void* ctx)
+{
+    StratumServer* self = static_cast<StratumServer*>(ctx);
+    struct evbuffer* input = bufferevent_get_input(bev);
+    size_t n_read_out = 0;
+    char* line;
+    //  If there is not a whole line to read, evbuffer_readln returns nullptr
+    while ((line = evbuffer_readln(input, &n_read_out, EVBUFFER_EOL_CRLF)) != nullptr) {
+        std::string s(line, n_read_out);
+        free(line);
+        if (s.empty()) {
+            continue;
+        }
+        if (!self->ProcessRequest(bev, self->mapClients[bev], s)) {
+            LogPrint(BCLog::STRATUM, "stratum: Malformed request, dropping miner\n");
+            self->Disconnect(bev);
+            return;
+        }
+    }
+    if (evbuffer_get_length(input) > STRATUM_MAX_LINE_LENGTH) {
+        LogPrint(BCLog::STRATUM, "stratum: Request too long, dropping miner\n");
+        self->Disconnect(bev);
+    }
+}
+
+void StratumServer::eventcb(struct bufferevent* bev, short what, void* ctx)
+{
+    StratumServer* self = static_cast<StratumServer*>(ctx);
+    if (what & (BEV_EVENT_EOF|BEV_EVENT_ERROR)) {
+        self->Disconnect(bev);
+    }
+}
+
+void StratumServer::tip_cb(evutil_socket_t fd, short what, void* arg)
+{
+    StratumServer* self = static_cast<StratumServer*>(arg);
+    self->NewJob(true);
+}
+
+void StratumServer::refresh_cb(evutil_socket_t fd, short what, void* arg)
+{
+    StratumServer* self = static_cast<StratumServer*>(arg);
+    if (mempool.GetTransactionsUpdated() != self->nTransactionsUpdatedLast) {
+        self->NewJob(false);
+    }
+}
+
+/****** Thread ********/
+static struct event_base* gBase;
+static std::thread stratumThread;
+static std::unique_ptr<StratumServer> gServer;
+
+static void StratumThread()
+{
+    event_base_dispatch(gBase);
+}
+
+bool StartStratum()
+{
+    assert(!gBase);
+
+    CTxDestination dest = DecodeDestination(gArgs.GetArg("-stratumaddress", ""));
+    if (!IsValidDestination(dest)) {
+        return InitError(_("-stratum requires a valid -stratumaddress to pay mined blocks to"));
+    }
+
+    double dDifficulty = DEFAULT_STRATUM_DIFFICULTY;
+    if (gArgs.IsArgSet("-stratumdifficulty")) {
+        dDifficulty = atof(gArgs.GetArg("-stratumdifficulty", "").c_str());
+        if (!(dDifficulty >= 0)) {
+            return InitError(strprintf(_("Invalid -stratumdifficulty: '%s'"), gArgs.GetArg("-stratumdifficulty", "")));
+        }
+    }
+
+    std::string strBind = gArgs.GetArg("-stratumbind", DEFAULT_STRATUM_BIND);
+    CService addrBind;
+    if (!Lookup(strBind.c_str(), addrBind, gArgs.GetArg("-stratumport", DEFAULT_STRATUM_PORT), false)) {
+        return InitError(strprintf(_("Cannot resolve -%s address: '%s'"), "stratumbind", strBind));
+    }
+
+#ifdef WIN32
+    evthread_use_windows_threads();
+#else
+    evthread_use_pthreads();
+#endif
+    gBase = event_base_new();
+    if (!gBase) {
+        return InitError(_("Unable to create the stratum event base"));
+    }
+
+    gServer.reset(new StratumServer(gBase, GetScriptForDestination(dest), dDifficulty));
+    if (!gServer->Listen(addrBind)) {
+        gServer.reset();
+        event_base_free(gBase);
+        gBase = nullptr;
+        return InitError(strprintf(_("Unable to bind stratum to %s"), addrBind.ToString()));
+    }
+    RegisterValidationInterface(gServer.get());
+    LogPrintf("stratum: Listening on %s\n", addrBind.ToString());
+
+    stratumThread = std::thread(std::bind(&TraceThread<void (*)()>, "stratum", &StratumThread));
+    return true;
+}
+
+void InterruptStratum()
+{
+    if (gBase) {
+        LogPrintf("stratum: Thread interrupt\n");
+        event_base_loopbreak(gBase);
+    }
+}
+
+void StopStratum()
+{
+    if (gBase) {
+        UnregisterValidationInterface(gServer.get());
+        stratumThread.join();
+        gServer.reset();
+        event_base_free(gBase);
+        gBase = nullptr;
+    }
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Built-in stratum endpoint for external X16R miners.
+ */
+#ifndef BITCOIN_STRATUM_H
+#define BITCOIN_STRATUM_H
+
+#include <primitives/block.h>
+#include <script/script.h>
+#include <uint256.h>
+
+#include <string>
+#include <vector>
+
+static const bool DEFAULT_STRATUM = false;
+static const unsigned short DEFAULT_STRATUM_PORT = 3333;
+static const std::string DEFAULT_STRATUM_BIND = "127.0.0.1";
+/** Share difficulty handed to miners, 0 means the block difficulty */
+static const double DEFAULT_STRATUM_DIFFICULTY = 0;
+/** Size of the per-connection extranonce prefix */
+static const unsigned int STRATUM_EXTRANONCE1_SIZE = 4;
+/** Size of the extranonce part rolled by the miner */
+static const unsigned int STRATUM_EXTRANONCE2_SIZE = 4;
+
+/**
+ * A block template split up the way stratum miners expect it: the coinbase
+ * is cut around the extranonce and only the merkle branch of the coinbase
+ * is sent, so a miner can build the header without seeing the transactions.
+ */
+class CStratumJob
+{
+public:
+    /** The template the job was made from */
+    CBlock block;
+    /** Hex of the non-witness coinbase before and after the extranonce */
+    std::string coinb1;
+    std::string coinb2;
+    /** Hashes to combine with the coinbase txid, bottom up */
+    std::vector<uint256> merkleBranch;
+
+    CStratumJob(const CBlock& blockIn, int nHeight);
+
+    /** Rebuild the block a miner worked on */
+    CBlock GetBlock(const std::vector<unsigned char>& vchExtraNonce, uint32_t nTime, uint32_t nNonce) const;
+
+private:
+    /** Coinbase scriptSig up to the extranonce push */
+    CScript scriptSigPrefix;
+};
+
+bool StartStratum();
+void InterruptStratum();
+void StopStratum();
+
+#endif /* BITCOIN_STRATUM_H */
@@ -147,4 +147,166 @@ BOOST_AUTO_TEST_CASE(siphash)
     }
 }
 
+/**
+ * HashX16R as computed by the original implementation (one sph context per
+ * round). The previous block hashes rotate the algorithm order, so every
+ * algorithm runs in the first round, on the 80 or 64 byte input, and in the
+ * later rounds on the 64 byte hash of the round before. Byte j of the input
+ * of vector k is k * 16 + j.
+ */
+static const struct {
+    const char* prev;
+    const char* hash80;
+    const char* hash64;
+} x16r_vectors[] = {
+    {"00000000000000000000000000000000000000000000000f0123456789abcdef",
+     "ae8b57cee4e094302eb8e84ace08309f646c5bb002da5c29bae14d4145eaff48",
+     "a0454deda4bbd1684b810f87a156513912aa01b6ee3104616d65bcf5b7260b3a"},
+    {"00000000000000000000000000000000000000000000000f123456789abcdef0",
+     "3c7377567dcdd10fa235a32e6d6af0cc784e2952aee142adea65f8e2bbb144af",
+     "e4a8e0988a64ac18bccbbd84a0631413bcb6decb3066b2cf7b63d599c530c69b"},
+    {"00000000000000000000000000000000000000000000000f23456789abcdef01",
+     "d88e7074743fceb499240a7e34be2be8132297aa308450a57639d726e6f41109",
+     "f3b1fce036b8e60a1adfd39b7a20f73758a80b1d145713619ec75255ca60f05b"},
+    {"00000000000000000000000000000000000000000000000f3456789abcdef012",
+     "f2a31f35a895a0455cd4e013ecd3f40ba17bab6c16a8b49eead98da886b4b59d",
+     "37f3324aa41457f06f7528172754a052378a01daeb523d033648274fe365a87e"},
+    {"00000000000000000000000000000000000000000000000f456789abcdef0123",
+     "a10cfc69a6ea0123733b413a4fdb0fc888e95c6ee4f5f430612da38850fbea65",
+     "4e2c5f0aed8d1de885d0d422d312f22094bf7e3a4c5c8730771ec01a86cade1d"},
+    {"00000000000000000000000000000000000000000000000f56789abcdef01234",
+     "349f0570d8c44ecb0a17b384e0bfc5c42ca13746c615433d2af0263e337837b8",
+     "5e3cb06a6931a89cc8b126117dbdd376d77dec9a83348169c5a6d19a72d9da0e"},
+    {"00000000000000000000000000000000000000000000000f6789abcdef012345",
+     "08fb75a3224abe884509916795354fcd4eb98612b8e0b8e327e1b9072f5e4a3b",
+     "fe1a887996aa320792b2a4646cf605f0b1bd7ca162e21db79fe596862b170c50"},
+    {"00000000000000000000000000000000000000000000000f789abcdef0123456",
+     "381da7a575254f99aee71f62ef598d6edb447f7cbac98d570de516f4e544732d",
+     "dbdc6deee6f0fa8387c814f155acd62957b6a6a1434996d00ecf25b2929e9794"},
+    {"00000000000000000000000000000000000000000000000f89abcdef01234567",
+     "0ff0bd6ee8adcc831dcb18a1195b2cd544a91ef21119468598de0631b6520172",
+     "bb47d46dfe6003405e16592ddc9e98fa6b6409a974942af0fdc451795d7a35fa"},
+    {"00000000000000000000000000000000000000000000000f9abcdef012345678",
+     "443ea99945693325be841124d0e8ab3117f97e9bcb41005c25f208b6fb15d1f7",
+     "79887c24668dae02841ae2b1162c81b31a5e0c4d17d9d65ae2fe00694295ec32"},
+    {"00000000000000000000000000000000000000000000000fabcdef0123456789",
+     "f81f46a3698c961d198d80d686087aecc8fffcd3759f8b4fc59d639ebd7fa3e3",
+     "4002c72ab51a285261969d0ba04e7c4a5f6fa856cd860e3a7b236b901917a8dd"},
+    {"00000000000000000000000000000000000000000000000fbcdef0123456789a",
+     "77ac038a57f2bfc49012e55ad5469fea2021b5bab4d267050252d70a8739792f",
+     "a6075e088a1f21d10ff3a2f7a0126546889111b95506f8edcec7c188ecb0edf6"},
+    {"00000000000000000000000000000000000000000000000fcdef0123456789ab",
+     "9c6317102e6e4b59be967854eb63e95b728ad61ae428f6069b4f4c8ea7ff7c94",
+     "f00650001d1b1f40f317bf5b4fe3be5e74252fcf8bd321944d27fff5a7bfce23"},
+    {"00000000000000000000000000000000000000000000000fdef0123456789abc",
+     "d194d141e530dcf42534a4c85186bbf8d8b3489a446aa7036d1c224229af2f58",
+     "f36ddf7c2f099a6c51f450588c5967e131c5433e841a85628ef5ae3e4671f987"},
+    {"00000000000000000000000000000000000000000000000fef0123456789abcd",
+     "0eab0866dd9d724dbeede06f980ee527ad3bc5c45b37accf9af02868ed416e9c",
+     "22e6125bbbfe173bf4a3c294b9f101f845ec85f6f4c63864f7d3187b1f99b711"},
+    {"00000000000000000000000000000000000000000000000ff0123456789abcde",
+     "f21feb62401f511e298eccf2d5ddf5c0bb625fe072cf6ac731501f5bb0f965bd",
+     "2ce6ff8d7bbc4ff6d3c8d4a104730dbaaaf42de544f165544e26e33de5fd6554"}
+};
+
+BOOST_AUTO_TEST_CASE(x16r_known_answers)
+{
+    const size_t count = X16R_LANES + 1;
+    for (size_t k = 0; k < ARRAYLEN(x16r_vectors); k++) {
+        const uint256 prev = uint256S(x16r_vectors[k].prev);
+        const uint256 hash80 = uint256S(x16r_vectors[k].hash80);
+        const uint256 hash64 = uint256S(x16r_vectors[k].hash64);
+        BOOST_CHECK_EQUAL(GetHashSelection(prev, 0), (int)k);
+
+        std::vector<unsigned char> input80(80 * count), input64(64 * count);
+        for (size_t i = 0; i < count; i++) {
+            for (size_t j = 0; j < 80; j++)
+                input80[80 * i + j] = k * 16 + j;
+            for (size_t j = 0; j < 64; j++)
+                input64[64 * i + j] = k * 16 + j;
+        }
+        BOOST_CHECK_EQUAL(HashX16R(input80.begin(), input80.begin() + 80, prev), hash80);
+        BOOST_CHECK_EQUAL(HashX16R(input64.begin(), input64.begin() + 64, prev), hash64);
+
+        // every lane of a batch, with and without a plan
+        std::vector<uint256> hashes(count);
+        HashX16RBatch(input80.data(), 80, count, prev, hashes.data());
+        for (const uint256& hash : hashes)
+            BOOST_CHECK_EQUAL(hash, hash80);
+        HashX16RBatch(input64.data(), 64, count, prev, hashes.data());
+        for (const uint256& hash : hashes)
+            BOOST_CHECK_EQUAL(hash, hash64);
+
+        int order[X16R_ALGOS];
+        GetHashSelections(prev, order);
+        X16RPlan plan(order);
+        HashX16RBatch(plan, input80.data(), 80, count, hashes.data());
+        for (const uint256& hash : hashes)
+            BOOST_CHECK_EQUAL(hash, hash80);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(x16r_batch)
+{
+    // Batches that fill, and stop short of, the SIMD and X16R_LANES widths
+    // must hash every input exactly like HashX16R does on its own
+    for (size_t count = 1; count <= 2 * X16R_LANES + 3; count++) {
+        const uint256 prev = InsecureRand256();
+        for (size_t len : {64, 80}) {
+            const std::vector<unsigned char> input = insecure_rand_ctx.randbytes(len * count);
+            std::vector<uint256> hashes(count);
+            HashX16RBatch(input.data(), len, count, prev, hashes.data());
+            for (size_t i = 0; i < count; i++) {
+                const unsigned char* begin = input.data() + len * i;
+                BOOST_CHECK_EQUAL(hashes[i], HashX16R(begin, begin + len, prev));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(x16r_plan)
+{
+    // one plan hashes any number of batches like HashX16R
+    const uint256 prev = InsecureRand256();
+    int order[X16R_ALGOS];
+    GetHashSelections(prev, order);
+    X16RPlan plan(order);
+    for (size_t count = 1; count <= X16R_LANES + 1; count++) {
+        const std::vector<unsigned char> input = insecure_rand_ctx.randbytes(80 * count);
+        std::vector<uint256> hashes(count);
+        HashX16RBatch(plan, input.data(), 80, count, hashes.data());
+        for (size_t i = 0; i < count; i++) {
+            const unsigned char* begin = input.data() + 80 * i;
+            BOOST_CHECK_EQUAL(hashes[i], HashX16R(begin, begin + 80, prev));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(x16r_stats)
+{
+    uint64_t hashes_before[X16R_ALGOS], hashes_after[X16R_ALGOS], nanos[X16R_ALGOS];
+    const uint256 prev = InsecureRand256();
+    const std::vector<unsigned char> input = insecure_rand_ctx.randbytes(80 * 3);
+    std::vector<uint256> hashes(3);
+
+    // nothing is counted unless enabled
+    X16RGetStats(hashes_before, nanos);
+    HashX16RBatch(input.data(), 80, 3, prev, hashes.data());
+    X16RGetStats(hashes_after, nanos);
+    for (int algo = 0; algo < X16R_ALGOS; algo++)
+        BOOST_CHECK_EQUAL(hashes_after[algo], hashes_before[algo]);
+
+    // every round counts each input once for the algorithm it used
+    X16RSetStatsEnabled(true);
+    HashX16RBatch(input.data(), 80, 3, prev, hashes.data());
+    X16RSetStatsEnabled(false);
+    X16RGetStats(hashes_after, nanos);
+    for (int algo = 0; algo < X16R_ALGOS; algo++) {
+        uint64_t expected = 0;
+        for (int round = 0; round < X16R_ALGOS; round++)
+            expected += GetHashSelection(prev, round) == algo ? 3 : 0;
+        BOOST_CHECK_EQUAL(hashes_after[algo] - hashes_before[algo], expected);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
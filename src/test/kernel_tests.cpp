@@ -0,0 +1,511 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <consensus/merkle.h>
+#include <index/txindex.h>
+#include <kernel.h>
+#include <key.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <txdb.h>
+#include <utilmemory.h>
+#include <validation.h>
+#include <test/test_bitcoin.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(kernel_tests, BasicTestingSetup)
+
+// Reference implementation: walk the chain forward from pindexFrom, as the
+// kernel did before the stake modifier index existed.
+static const CBlockIndex* WalkForModifierBlock(const CChain& chain, const CBlockIndex* pindexFrom, int64_t nSelectionInterval)
+{
+    int64_t nStakeModifierTime = pindexFrom->GetBlockTime();
+    const CBlockIndex* pindex = pindexFrom;
+    const CBlockIndex* pindexNext = chain[pindexFrom->nHeight + 1];
+    while (nStakeModifierTime < pindexFrom->GetBlockTime() + nSelectionInterval) {
+        if (!pindexNext)
+            return nullptr;
+        pindex = pindexNext;
+        pindexNext = chain[pindexNext->nHeight + 1];
+        if (pindex->GeneratedStakeModifier())
+            nStakeModifierTime = pindex->GetBlockTime();
+    }
+    return pindex;
+}
+
+static void BuildBranch(std::vector<CBlockIndex>& vBlocks, CBlockIndex* pindexParent, int64_t nTimeStart)
+{
+    int64_t nTime = nTimeStart;
+    for (unsigned int i = 0; i < vBlocks.size(); i++) {
+        CBlockIndex& block = vBlocks[i];
+        block.pprev = i ? &vBlocks[i - 1] : pindexParent;
+        block.nHeight = block.pprev ? block.pprev->nHeight + 1 : 0;
+        // block times are not strictly increasing
+        nTime += 60 + InsecureRandRange(120);
+        block.nTime = InsecureRandRange(8) ? nTime : nTime - 200;
+        block.SetStakeModifier(InsecureRand32(), InsecureRandRange(4) == 0);
+        block.BuildSkip();
+    }
+}
+
+static void CheckAgainstWalk(const CChain& chain, const std::vector<CBlockIndex>& vBlocks)
+{
+    const int64_t nSelectionInterval = 2087;
+    for (int i = 0; i < 500; i++) {
+        const CBlockIndex* pindexFrom = &vBlocks[InsecureRandRange(vBlocks.size())];
+        const CBlockIndex* pindexExpected = WalkForModifierBlock(chain, pindexFrom, nSelectionInterval);
+        const CBlockIndex* pindex = nullptr;
+        BOOST_CHECK_EQUAL(stakeModifierIndex.GetModifierBlock(chain, pindexFrom, nSelectionInterval, pindex), pindexExpected != nullptr);
+        if (pindexExpected)
+            BOOST_CHECK(pindex == pindexExpected);
+    }
+}
+
+// Reference implementation: the stake modifier selection as it was before
+// candidates were kept between blocks.
+static int64_t ReferenceSelectionIntervalSection(int nSection)
+{
+    return nModifierInterval * 63 / (63 + ((63 - nSection) * (MODIFIER_INTERVAL_RATIO - 1)));
+}
+
+static bool ReferenceSelectBlockFromCandidates(const std::map<uint256, const CBlockIndex*>& mapIndex,
+        std::vector<std::pair<int64_t, uint256> >& vSortedByTimestamp,
+        std::map<uint256, const CBlockIndex*>& mapSelectedBlocks,
+        int64_t nSelectionIntervalStop, uint64_t nStakeModifierPrev,
+        const CBlockIndex** pindexSelected)
+{
+    bool fSelected = false;
+    arith_uint256 hashBest;
+    *pindexSelected = nullptr;
+    for (const auto& item : vSortedByTimestamp) {
+        const CBlockIndex* pindex = mapIndex.at(item.second);
+        if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
+            break;
+        if (mapSelectedBlocks.count(pindex->GetBlockHash()) > 0)
+            continue;
+        uint256 hashProof = pindex->IsProofOfStake() ? pindex->hashProofOfStake : pindex->GetBlockHash();
+        CDataStream ss(SER_GETHASH, 0);
+        ss << hashProof << nStakeModifierPrev;
+        arith_uint256 hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
+        if (pindex->IsProofOfStake())
+            hashSelection >>= 32;
+        if (!fSelected || hashSelection < hashBest) {
+            fSelected = true;
+            hashBest = hashSelection;
+            *pindexSelected = pindex;
+        }
+    }
+    return fSelected;
+}
+
+static bool ReferenceNextStakeModifier(const std::map<uint256, const CBlockIndex*>& mapIndex, const CBlockIndex* pindexCurrent, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    const CBlockIndex* pindexPrev = pindexCurrent->pprev;
+    nStakeModifier = 0;
+    fGeneratedStakeModifier = false;
+    if (!pindexPrev) {
+        fGeneratedStakeModifier = true;
+        return true;
+    }
+    const CBlockIndex* pindexLast = pindexPrev;
+    while (pindexLast->pprev && !pindexLast->GeneratedStakeModifier())
+        pindexLast = pindexLast->pprev;
+    int64_t nModifierTime = 0;
+    if (pindexLast->GeneratedStakeModifier()) {
+        nStakeModifier = pindexLast->nStakeModifier;
+        nModifierTime = pindexLast->GetBlockTime();
+    }
+    if (nModifierTime / params.nModifierInterval >= pindexPrev->GetBlockTime() / params.nModifierInterval)
+        return true;
+
+    std::vector<std::pair<int64_t, uint256> > vSortedByTimestamp;
+    int64_t nSelectionInterval = 0;
+    for (int nSection = 0; nSection < 64; nSection++)
+        nSelectionInterval += ReferenceSelectionIntervalSection(nSection);
+    int64_t nSelectionIntervalStart = (pindexPrev->GetBlockTime() / params.nModifierInterval) * params.nModifierInterval - nSelectionInterval;
+    const CBlockIndex* pindex = pindexPrev;
+    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
+        vSortedByTimestamp.push_back(std::make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
+        pindex = pindex->pprev;
+    }
+    std::reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+    std::sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+
+    uint64_t nStakeModifierNew = 0;
+    int64_t nSelectionIntervalStop = nSelectionIntervalStart;
+    std::map<uint256, const CBlockIndex*> mapSelectedBlocks;
+    for (int nRound = 0; nRound < std::min(64, (int)vSortedByTimestamp.size()); nRound++) {
+        nSelectionIntervalStop += ReferenceSelectionIntervalSection(nRound);
+        if (!ReferenceSelectBlockFromCandidates(mapIndex, vSortedByTimestamp, mapSelectedBlocks, nSelectionIntervalStop, nStakeModifier, &pindex))
+            return false;
+        nStakeModifierNew |= (((uint64_t)pindex->GetStakeEntropyBit()) << nRound);
+        mapSelectedBlocks.insert(std::make_pair(pindex->GetBlockHash(), pindex));
+    }
+    nStakeModifier = nStakeModifierNew;
+    fGeneratedStakeModifier = true;
+    return true;
+}
+
+// Build a branch computing each block's stake modifier as validation does,
+// checking it against the reference implementation.
+static void BuildModifierBranch(std::vector<CBlockIndex>& vBlocks, std::vector<uint256>& vHashes, std::map<uint256, const CBlockIndex*>& mapIndex,
+                                CBlockIndex* pindexParent, int64_t nTimeStart, int& nGenerated)
+{
+    vHashes.resize(vBlocks.size());
+    int64_t nTime = nTimeStart;
+    for (unsigned int i = 0; i < vBlocks.size(); i++) {
+        CBlockIndex& block = vBlocks[i];
+        vHashes[i] = InsecureRand256();
+        block.phashBlock = &vHashes[i];
+        block.pprev = i ? &vBlocks[i - 1] : pindexParent;
+        block.nHeight = block.pprev ? block.pprev->nHeight + 1 : 0;
+        // block times are not strictly increasing
+        nTime += 5 + InsecureRandRange(50);
+        block.nTime = InsecureRandRange(8) ? nTime : nTime - 120;
+        if (InsecureRandBool()) {
+            block.SetProofOfStake();
+            block.hashProofOfStake = InsecureRand256();
+        }
+        block.BuildSkip();
+        mapIndex[vHashes[i]] = &block;
+
+        uint64_t nStakeModifier, nStakeModifierExpected;
+        bool fGenerated, fGeneratedExpected;
+        BOOST_CHECK(ComputeNextStakeModifier(&block, nStakeModifier, fGenerated));
+        BOOST_CHECK(ReferenceNextStakeModifier(mapIndex, &block, nStakeModifierExpected, fGeneratedExpected));
+        BOOST_CHECK_EQUAL(nStakeModifier, nStakeModifierExpected);
+        BOOST_CHECK_EQUAL(fGenerated, fGeneratedExpected);
+        block.SetStakeModifier(nStakeModifier, fGenerated);
+        if (fGenerated)
+            nGenerated++;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(stake_modifier_candidates)
+{
+    stakeModifierCandidates.Clear();
+
+    std::map<uint256, const CBlockIndex*> mapIndex;
+    int nGenerated = 0;
+    std::vector<uint256> vHashesMain, vHashesFork, vHashesMain2, vHashesFork2;
+    std::vector<CBlockIndex> vBlocksMain(1500), vBlocksFork(300), vBlocksMain2(500), vBlocksFork2(200);
+    BuildModifierBranch(vBlocksMain, vHashesMain, mapIndex, nullptr, 1500000000, nGenerated);
+    // switching between branches moves the window back to the fork point
+    BuildModifierBranch(vBlocksFork, vHashesFork, mapIndex, &vBlocksMain[1400], vBlocksMain[1400].nTime, nGenerated);
+    BuildModifierBranch(vBlocksMain2, vHashesMain2, mapIndex, &vBlocksMain.back(), vBlocksMain.back().nTime, nGenerated);
+    BuildModifierBranch(vBlocksFork2, vHashesFork2, mapIndex, &vBlocksFork[100], vBlocksFork[100].nTime, nGenerated);
+
+    // make sure modifiers were actually generated along the way
+    BOOST_CHECK(nGenerated > 100);
+
+    stakeModifierCandidates.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(stake_modifier_index)
+{
+    std::vector<CBlockIndex> vBlocksMain(2000);
+    BuildBranch(vBlocksMain, nullptr, 1500000000);
+
+    // a fork off the main chain that ends up with more blocks
+    std::vector<CBlockIndex> vBlocksFork(600);
+    BuildBranch(vBlocksFork, &vBlocksMain[1699], vBlocksMain[1699].nTime);
+
+    stakeModifierIndex.Clear();
+
+    CChain chain;
+    chain.SetTip(&vBlocksMain[999]);
+    CheckAgainstWalk(chain, vBlocksMain);
+
+    chain.SetTip(&vBlocksMain.back());
+    CheckAgainstWalk(chain, vBlocksMain);
+
+    chain.SetTip(&vBlocksFork.back());
+    CheckAgainstWalk(chain, vBlocksMain);
+    CheckAgainstWalk(chain, vBlocksFork);
+
+    chain.SetTip(&vBlocksMain[1200]);
+    CheckAgainstWalk(chain, vBlocksMain);
+
+    stakeModifierIndex.Clear();
+}
+
+static CBlock BlockSpending(const std::vector<COutPoint>& vSpent)
+{
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    CMutableTransaction tx;
+    for (const COutPoint& outpoint : vSpent)
+        tx.vin.emplace_back(outpoint);
+    block.vtx.push_back(MakeTransactionRef(tx));
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(stake_spent_index)
+{
+    const int nMaxDepth = 10;
+    CStakeSpentIndex index;
+    // reference: the map ConnectBlock used to keep and prune in full
+    std::map<COutPoint, int> mapReference;
+    std::vector<CBlock> vConnected;
+    std::vector<COutPoint> vAllSpent;
+
+    for (int i = 0; i < 400; i++) {
+        if (!vConnected.empty() && InsecureRandRange(4) == 0) {
+            // disconnect the tip
+            const CBlock& block = vConnected.back();
+            int nHeight = vConnected.size() - 1;
+            index.DisconnectBlock(block, nHeight);
+            for (const CTxIn& txin : block.vtx[1]->vin)
+                mapReference.erase(txin.prevout);
+            vConnected.pop_back();
+            continue;
+        }
+
+        std::vector<COutPoint> vSpent;
+        for (int j = InsecureRandRange(6); j > 0; j--) {
+            // occasionally respend an outpoint whose spend was disconnected
+            if (!vAllSpent.empty() && InsecureRandRange(8) == 0)
+                vSpent.push_back(vAllSpent[InsecureRandRange(vAllSpent.size())]);
+            else
+                vSpent.emplace_back(InsecureRand256(), InsecureRandRange(4));
+        }
+        vAllSpent.insert(vAllSpent.end(), vSpent.begin(), vSpent.end());
+
+        int nHeight = vConnected.size();
+        vConnected.push_back(BlockSpending(vSpent));
+        index.ConnectBlock(vConnected.back(), nHeight, nMaxDepth);
+        for (const COutPoint& outpoint : vSpent)
+            mapReference.insert(std::make_pair(outpoint, nHeight));
+        for (auto it = mapReference.begin(); it != mapReference.end();) {
+            if (it->second < nHeight - nMaxDepth)
+                it = mapReference.erase(it);
+            else
+                it++;
+        }
+
+        BOOST_CHECK_EQUAL(index.size(), mapReference.size());
+        for (const COutPoint& outpoint : vAllSpent) {
+            auto it = mapReference.find(outpoint);
+            int nSpentHeight = -1;
+            BOOST_CHECK_EQUAL(index.GetSpentHeight(outpoint, nSpentHeight), it != mapReference.end());
+            if (it != mapReference.end())
+                BOOST_CHECK_EQUAL(nSpentHeight, it->second);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(fork_spent_index)
+{
+    std::vector<CBlockIndex> vBlocksMain(200);
+    BuildBranch(vBlocksMain, nullptr, 1500000000);
+    std::vector<CBlockIndex> vBlocksFork(30);
+    BuildBranch(vBlocksFork, &vBlocksMain[149], vBlocksMain[149].nTime);
+    // a second fork off the first one
+    std::vector<CBlockIndex> vBlocksFork2(10);
+    BuildBranch(vBlocksFork2, &vBlocksFork[9], vBlocksFork[9].nTime);
+
+    CChain chain;
+    chain.SetTip(&vBlocksMain.back());
+
+    const COutPoint spentMain(InsecureRand256(), 0);
+    const COutPoint spentFork(InsecureRand256(), 1);
+    const COutPoint spentFork2(InsecureRand256(), 2);
+    const COutPoint spentLateFork(InsecureRand256(), 3);
+
+    CForkSpentIndex index;
+    for (unsigned int i = 0; i < vBlocksMain.size(); i++) {
+        std::vector<COutPoint> vSpent{COutPoint(InsecureRand256(), 0)};
+        if (i == 160) vSpent.push_back(spentMain);
+        index.AddBlock(BlockSpending(vSpent), &vBlocksMain[i]);
+    }
+    for (unsigned int i = 0; i < vBlocksFork.size(); i++) {
+        std::vector<COutPoint> vSpent{COutPoint(InsecureRand256(), 0)};
+        if (i == 5) vSpent.push_back(spentFork);
+        if (i == 20) vSpent.push_back(spentLateFork);
+        index.AddBlock(BlockSpending(vSpent), &vBlocksFork[i]);
+    }
+    for (unsigned int i = 0; i < vBlocksFork2.size(); i++) {
+        std::vector<COutPoint> vSpent{COutPoint(InsecureRand256(), 0)};
+        if (i == 3) vSpent.push_back(spentFork2);
+        index.AddBlock(BlockSpending(vSpent), &vBlocksFork2[i]);
+    }
+
+    auto IsSpent = [&](const COutPoint& outpoint, const CBlockIndex* pindexPrev) {
+        CMutableTransaction tx;
+        tx.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+        tx.vin.emplace_back(outpoint);
+        return index.IsSpentOnFork(CTransaction(tx), pindexPrev, chain, Params().GetConsensus());
+    };
+
+    // spent by an ancestor on the fork
+    BOOST_CHECK(IsSpent(spentFork, &vBlocksFork.back()));
+    BOOST_CHECK(IsSpent(spentFork, &vBlocksFork[5]));
+    BOOST_CHECK(IsSpent(spentFork, &vBlocksFork2.back()));
+    BOOST_CHECK(IsSpent(spentFork2, &vBlocksFork2.back()));
+    BOOST_CHECK(IsSpent(spentLateFork, &vBlocksFork.back()));
+    // not an ancestor of the block being built on
+    BOOST_CHECK(!IsSpent(spentFork, &vBlocksFork[4]));
+    BOOST_CHECK(!IsSpent(spentFork2, &vBlocksFork.back()));
+    BOOST_CHECK(!IsSpent(spentLateFork, &vBlocksFork2.back()));
+    // spends on the active chain are left to the coins view
+    BOOST_CHECK(!IsSpent(spentMain, &vBlocksFork.back()));
+    BOOST_CHECK(!IsSpent(COutPoint(InsecureRand256(), 0), &vBlocksFork.back()));
+
+    // pruning forgets everything below the given height
+    const size_t nSize = index.size();
+    index.Prune(156);
+    BOOST_CHECK(!index.HaveBlock(&vBlocksMain[155]));
+    BOOST_CHECK(!index.HaveBlock(&vBlocksFork[5]));
+    BOOST_CHECK(index.HaveBlock(&vBlocksMain[156]));
+    BOOST_CHECK(index.HaveBlock(&vBlocksFork[6]));
+    BOOST_CHECK_EQUAL(index.size(), nSize - 156 - 6 - 1);
+
+    index.Clear();
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(stake_kernel_search)
+{
+    std::vector<CBlockIndex> vBlocks(1000);
+    BuildBranch(vBlocks, nullptr, 1500000000);
+
+    stakeModifierIndex.Clear();
+    chainActive.SetTip(&vBlocks.back());
+    stakeModifierIndex.Sync(chainActive);
+
+    const CAmount nMinStakeAmount = Params().GetConsensus().nMinStakeAmount;
+    const int nStakeMinAge = Params().GetConsensus().nStakeMinAge;
+    for (int i = 0; i < 200; i++) {
+        const CBlockIndex* pindexFrom = &vBlocks[InsecureRandRange(vBlocks.size() / 2)];
+        const CAmount nValueIn = nMinStakeAmount + InsecureRandRange(1000 * COIN);
+        const COutPoint prevout(InsecureRand256(), InsecureRandRange(8));
+        const unsigned int nBits = 0x1d00ffff + InsecureRandRange(8) * 0x01000000;
+        const unsigned int nTimeTx = pindexFrom->GetBlockTime() + nStakeMinAge + InsecureRandRange(100000);
+
+        CStakeKernelSearch search(nBits, pindexFrom, sizeof(CBlock), nValueIn, prevout);
+        BOOST_CHECK(search.IsValid());
+
+        uint256 vHashes[CStakeKernelSearch::BATCH_SIZE];
+        const size_t nCount = 1 + InsecureRandRange(CStakeKernelSearch::BATCH_SIZE);
+        search.Hash(nTimeTx, nCount, vHashes);
+        for (size_t j = 0; j < nCount; j++) {
+            uint256 hashProofOfStake;
+            bool fExpected = CheckStakeKernelHash(nBits, pindexFrom, sizeof(CBlock), nValueIn, prevout, nTimeTx - j, hashProofOfStake);
+            BOOST_CHECK(vHashes[j] == hashProofOfStake);
+            BOOST_CHECK_EQUAL(search.CheckTarget(nTimeTx - j, vHashes[j]), fExpected);
+        }
+    }
+
+    // below the minimum stake amount nothing can be staked
+    CStakeKernelSearch search(0x1d00ffff, &vBlocks[0], sizeof(CBlock), nMinStakeAmount - 1, COutPoint(InsecureRand256(), 0));
+    BOOST_CHECK(!search.IsValid());
+
+    chainActive.SetTip(nullptr);
+    stakeModifierIndex.Clear();
+}
+
+BOOST_FIXTURE_TEST_CASE(stake_input_lookup, TestingSetup)
+{
+    std::vector<CBlockIndex> vBlocks(1000);
+    BuildBranch(vBlocks, nullptr, 1500000000);
+
+    LOCK(cs_main);
+    CBlockIndex* pindexTipOld = chainActive.Tip();
+    chainActive.SetTip(&vBlocks.back());
+    stakeModifierIndex.Clear();
+    stakeModifierIndex.Sync(chainActive);
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    const CAmount nValue = Params().GetConsensus().nMinStakeAmount + 100 * COIN;
+
+    // the stake is the second output of a transaction confirmed at nHeightFrom
+    const int nHeightFrom = 100;
+    CMutableTransaction txPrev;
+    txPrev.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    txPrev.vout.emplace_back(COIN, CScript() << OP_TRUE);
+    txPrev.vout.emplace_back(nValue, scriptPubKey);
+    const COutPoint prevout(txPrev.GetHash(), 1);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.resize(1);
+    coinbase.vout[0].SetEmpty();
+    CMutableTransaction coinstake;
+    coinstake.vin.emplace_back(prevout);
+    coinstake.vout.resize(2);
+    coinstake.vout[0].SetEmpty();
+    coinstake.vout[1] = CTxOut(nValue, scriptPubKey);
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(MakeTransactionRef(coinstake));
+    block.nBits = 0x1d00ffff;
+    block.nTime = vBlocks[nHeightFrom].GetBlockTime() + Params().GetConsensus().nStakeMinAge + 600;
+
+    uint256 hashExpected;
+    const bool fExpected = CheckStakeKernelHash(block.nBits, &vBlocks[nHeightFrom], sizeof(CBlock), nValue, prevout, block.nTime, hashExpected, false, true);
+    BOOST_CHECK(!hashExpected.IsNull());
+
+    // unknown input
+    uint256 hashProofOfStake;
+    BOOST_CHECK(!CheckProofOfStake(block, hashProofOfStake, &vBlocks.back()));
+    BOOST_CHECK(hashProofOfStake.IsNull());
+
+    // value and height come from the coins view, there is no transaction index or block on disk
+    pcoinsTip->AddCoin(prevout, Coin(txPrev.vout[1], nHeightFrom, false, false), false);
+    BOOST_CHECK_EQUAL(CheckProofOfStake(block, hashProofOfStake, &vBlocks.back()), fExpected);
+    BOOST_CHECK(hashProofOfStake == hashExpected);
+
+    // spent on the active chain, as it is for a stake on a fork
+    BOOST_CHECK(pcoinsTip->SpendCoin(prevout));
+    hashProofOfStake.SetNull();
+    BOOST_CHECK(!CheckProofOfStake(block, hashProofOfStake, &vBlocks.back()));
+    BOOST_CHECK(hashProofOfStake.IsNull());
+
+    // then the previous transaction is looked up, here through the transaction index
+    CBlock blockFrom;
+    blockFrom.vtx.push_back(MakeTransactionRef(coinbase));
+    blockFrom.vtx.push_back(MakeTransactionRef(txPrev));
+    blockFrom.nTime = vBlocks[nHeightFrom].nTime;
+    blockFrom.hashMerkleRoot = BlockMerkleRoot(blockFrom);
+    const uint256 hashBlockFrom = blockFrom.GetHash();
+    vBlocks[nHeightFrom].phashBlock = &hashBlockFrom;
+    mapBlockIndex.emplace(hashBlockFrom, &vBlocks[nHeightFrom]);
+
+    const CDiskBlockPos blockPos(1000, 0);
+    {
+        CAutoFile fileout(OpenBlockFile(blockPos), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!fileout.IsNull());
+        fileout << blockFrom;
+    }
+    CDiskTxPos txPos(blockPos, GetSizeOfCompactSize(blockFrom.vtx.size()) + ::GetSerializeSize(*blockFrom.vtx[0], SER_DISK, CLIENT_VERSION));
+    g_txindex = MakeUnique<TxIndex>(MakeUnique<TxIndexDB>(1 << 20, true));
+    BOOST_CHECK(g_txindex->WriteIndex({std::make_pair(txPrev.GetHash(), txPos)}));
+
+    BOOST_CHECK_EQUAL(CheckProofOfStake(block, hashProofOfStake, &vBlocks.back()), fExpected);
+    BOOST_CHECK(hashProofOfStake == hashExpected);
+
+    g_txindex.reset();
+    mapBlockIndex.erase(hashBlockFrom);
+    chainActive.SetTip(pindexTipOld);
+    stakeModifierIndex.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
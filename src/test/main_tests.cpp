@@ -2,7 +2,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <chain.h>
 #include <chainparams.h>
+#include <hash.h>
 #include <validation.h>
 #include <net.h>
 
@@ -74,4 +76,41 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_FIXTURE_TEST_CASE(read_block_pow_valid, TestChain100Setup)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = chainActive.Tip();
+        // headers whose proof of work was checked on acceptance are flagged
+        for (const CBlockIndex* pwalk = pindex; pwalk; pwalk = pwalk->pprev) {
+            if (pwalk->nNonce || !pwalk->pprev)
+                BOOST_CHECK(pwalk->nStatus & BLOCK_POW_VALID);
+            // and their hash is kept
+            if (pwalk->nNonce) {
+                const CBlockHeader header = pwalk->GetBlockHeader();
+                BOOST_CHECK_EQUAL(pwalk->hashPoW, HashX16R(BEGIN(header.nVersion), END(header.nNonce), header.hashPrevBlock));
+            }
+        }
+        // as if the index was written before the flag existed
+        pindex->nStatus &= ~BLOCK_POW_VALID;
+        pindex->hashPoW.SetNull();
+    }
+
+    // the first read verifies the proof of work and flags the index
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, pindex, consensusParams));
+    BOOST_CHECK_EQUAL(block.GetHash(), pindex->GetBlockHash());
+    BOOST_CHECK(pindex->nStatus & BLOCK_POW_VALID);
+    if (block.IsProofOfWork())
+        BOOST_CHECK_EQUAL(pindex->hashPoW, block.GetPoWHash());
+
+    BOOST_CHECK(ReadBlockFromDisk(block, pindex, consensusParams));
+    fParanoidBlockReads = true;
+    BOOST_CHECK(ReadBlockFromDisk(block, pindex, consensusParams));
+    fParanoidBlockReads = DEFAULT_PARANOID_BLOCK_READS;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,611 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <consensus/merkle.h>
+#include <key.h>
+#include <masternode.h>
+#include <masternode-payments.h>
+#include <masternode-sync.h>
+#include <masternodeman.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <test/test_bitcoin.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+// block file the fixture writes its blocks to, far away from the ones the node uses
+static const int TEST_BLOCK_FILE = 1000;
+
+struct CMasternodeManTest
+{
+    static size_t RankCacheSize(CMasternodeMan& man)
+    {
+        LOCK(man.cs);
+        return man.mapRankCache.size();
+    }
+
+    static uint256 RankCacheBlockHash(CMasternodeMan& man, int nBlockHeight, int nMinProtocol)
+    {
+        LOCK(man.cs);
+        auto it = man.mapRankCache.find(std::make_pair(nBlockHeight, nMinProtocol));
+        return it == man.mapRankCache.end() ? uint256() : it->second.nBlockHash;
+    }
+
+    static int64_t CheckDeadline(CMasternodeMan& man, const COutPoint& outpoint)
+    {
+        LOCK(man.cs);
+        auto it = man.mapCheckDeadlines.find(outpoint);
+        return it == man.mapCheckDeadlines.end() ? -1 : it->second;
+    }
+
+    // turn the cached ranks upside down so that results served from the cache stand out
+    static bool ReverseCachedRanks(CMasternodeMan& man, int nBlockHeight, int nMinProtocol)
+    {
+        LOCK(man.cs);
+        auto it = man.mapRankCache.find(std::make_pair(nBlockHeight, nMinProtocol));
+        if (it == man.mapRankCache.end())
+            return false;
+        std::vector<COutPoint>& vecOutpoints = it->second.vecOutpoints;
+        std::reverse(vecOutpoints.begin(), vecOutpoints.end());
+        for (unsigned int i = 0; i < vecOutpoints.size(); i++)
+            it->second.mapRanks[vecOutpoints[i]] = i + 1;
+        return true;
+    }
+};
+
+struct MasternodeTestingSetup : public TestingSetup {
+    std::vector<CBlockIndex> vBlocks;
+    std::vector<uint256> vHashes;
+    CBlockIndex* pindexTipOld;
+    unsigned int nBlockFilePos;
+
+    MasternodeTestingSetup() : vBlocks(200), nBlockFilePos(0)
+    {
+        {
+            LOCK(cs_main);
+            pindexTipOld = chainActive.Tip();
+        }
+        // payments and ranks are only looked at once the winners list is synced
+        masternodeSync.Reset();
+        while (!masternodeSync.IsWinnersListSynced())
+            masternodeSync.SwitchToNextAsset(*connman);
+    }
+
+    ~MasternodeTestingSetup()
+    {
+        masternodeSync.Reset();
+        {
+            LOCK(cs_mapMasternodeBlocks);
+            mnpayments.mapMasternodeBlocks.clear();
+        }
+        {
+            LOCK(cs_main);
+            chainActive.SetTip(pindexTipOld);
+        }
+        SetMockTime(0);
+    }
+
+    // Build blocks on top of pindexParent. The coinbase of the block at height h
+    // pays mapPayees[h], those blocks are written to disk for UpdateLastPaid.
+    void BuildBranch(std::vector<CBlockIndex>& vBlocksIn, std::vector<uint256>& vHashesIn, CBlockIndex* pindexParent,
+                     const std::map<int, CScript>& mapPayees = std::map<int, CScript>())
+    {
+        vHashesIn.resize(vBlocksIn.size());
+        for (unsigned int i = 0; i < vBlocksIn.size(); i++) {
+            CBlockIndex& index = vBlocksIn[i];
+            index.pprev = i ? &vBlocksIn[i - 1] : pindexParent;
+            index.nHeight = index.pprev ? index.pprev->nHeight + 1 : 0;
+
+            auto it = mapPayees.find(index.nHeight);
+            CMutableTransaction coinbase;
+            coinbase.vin.resize(1);
+            coinbase.vin[0].prevout.SetNull();
+            // blocks at the same height differ between branches
+            coinbase.vin[0].scriptSig = CScript() << index.nHeight << (int64_t)InsecureRand32();
+            coinbase.vout.emplace_back(COIN, it != mapPayees.end() ? it->second : CScript() << OP_TRUE);
+
+            CBlock block;
+            block.nVersion = 1;
+            block.hashPrevBlock = index.pprev ? index.pprev->GetBlockHash() : uint256();
+            block.nTime = 1500000000 + index.nHeight * 60;
+            block.vtx.push_back(MakeTransactionRef(coinbase));
+            block.hashMerkleRoot = BlockMerkleRoot(block);
+
+            vHashesIn[i] = block.GetHash();
+            index.phashBlock = &vHashesIn[i];
+            index.nTime = block.nTime;
+            index.BuildSkip();
+            if (it != mapPayees.end())
+                WriteBlock(index, block);
+        }
+    }
+
+    void WriteBlock(CBlockIndex& index, const CBlock& block)
+    {
+        CDiskBlockPos pos(TEST_BLOCK_FILE, nBlockFilePos);
+        CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!fileout.IsNull());
+        nBlockFilePos += GetSerializeSize(fileout, block);
+        fileout << block;
+
+        LOCK(cs_main);
+        index.nFile = pos.nFile;
+        index.nDataPos = pos.nPos;
+        index.nStatus |= BLOCK_HAVE_DATA | BLOCK_POW_VALID;
+    }
+
+    void SetTip(CBlockIndex* pindex)
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(pindex);
+    }
+};
+
+static CMutableTransaction CollateralTx(CAmount nAmount, const CPubKey& pubKeyCollateral)
+{
+    CMutableTransaction tx;
+    tx.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    tx.vout.emplace_back(nAmount, GetScriptForDestination(pubKeyCollateral.GetID()));
+    return tx;
+}
+
+static CMasternode MakeMasternode(const COutPoint& outpoint, const CPubKey& pubKeyCollateral, int nProtocolVersion)
+{
+    CKey keyMasternode;
+    keyMasternode.MakeNewKey(true);
+    return CMasternode(CService(), outpoint, pubKeyCollateral, keyMasternode.GetPubKey(), nProtocolVersion);
+}
+
+static int CollateralTier(CAmount nValue)
+{
+    for (int i = 0; i < Params().CollateralLevels(); i++) {
+        if (nValue == Params().ValidCollateralAmounts()[i] * COIN)
+            return i;
+    }
+    return -1;
+}
+
+// Reference implementation: the election as it was before the payment queues,
+// filter the whole list, sort it by last paid block and score the first 11.
+static bool ReferenceNextInQueue(const std::map<COutPoint, CMasternode>& mapMasternodes, int nBlockHeight, bool fFilterSigTime,
+                                 int mnType, int& nCountRet, COutPoint& outpointRet)
+{
+    AssertLockHeld(cs_main);
+    const int nMinProto = mnpayments.GetMinMasternodePaymentsProto();
+
+    int nMnCount = 0;
+    for (const auto& mnpair : mapMasternodes) {
+        if (mnpair.second.nProtocolVersion >= nMinProto)
+            nMnCount++;
+    }
+
+    std::vector<std::pair<int, COutPoint> > vecLastPaid;
+    for (const auto& mnpair : mapMasternodes) {
+        const CMasternode& mn = mnpair.second;
+        if (!mn.IsValidForPayment()) continue;
+        if (mn.nProtocolVersion < nMinProto) continue;
+        if (fFilterSigTime && mn.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
+        Coin coin;
+        if (!pcoinsTip->GetCoin(mnpair.first, coin) || coin.IsSpent()) continue;
+        if (chainActive.Height() - coin.nHeight + 1 < Params().GetConsensus().nMasternodeMinimumConfirmations) continue;
+        if (CollateralTier(coin.out.nValue) != mnType) continue;
+        vecLastPaid.push_back(std::make_pair(mn.GetLastPaidBlock(), mnpair.first));
+    }
+
+    nCountRet = vecLastPaid.size();
+    std::sort(vecLastPaid.begin(), vecLastPaid.end());
+
+    const uint256 blockHash = chainActive[nBlockHeight - 101]->GetBlockHash();
+    arith_uint256 nHighest = 0;
+    outpointRet.SetNull();
+    for (unsigned int i = 0; i < vecLastPaid.size() && i < 11; i++) {
+        arith_uint256 nScore = mapMasternodes.at(vecLastPaid[i].second).CalculateScore(blockHash);
+        if (nScore > nHighest) {
+            nHighest = nScore;
+            outpointRet = vecLastPaid[i].second;
+        }
+    }
+    return !outpointRet.IsNull();
+}
+
+static void CheckPaymentQueue(CMasternodeMan& man, int nBlockHeight)
+{
+    LOCK(cs_main);
+    const std::map<COutPoint, CMasternode> mapMasternodes = man.GetFullMasternodeMap();
+    for (int nType = 0; nType < Params().CollateralLevels(); nType++) {
+        for (bool fFilterSigTime : {false, true}) {
+            int nCount, nCountExpected;
+            masternode_info_t mnInfo;
+            COutPoint outpointExpected;
+            bool fFound = man.GetNextMasternodeInQueueForPayment(nBlockHeight, fFilterSigTime, nCount, mnInfo, nType);
+            bool fFoundExpected = ReferenceNextInQueue(mapMasternodes, nBlockHeight, fFilterSigTime, nType, nCountExpected, outpointExpected);
+            BOOST_CHECK_EQUAL(fFound, fFoundExpected);
+            // only the head of the queue is counted now
+            BOOST_CHECK_EQUAL(nCount, std::min(nCountExpected, 11));
+            if (fFound && fFoundExpected)
+                BOOST_CHECK(mnInfo.vin.prevout == outpointExpected);
+        }
+    }
+}
+
+static std::vector<COutPoint> GetRanks(CMasternodeMan& man, int nBlockHeight, int nMinProtocol)
+{
+    CMasternodeMan::rank_pair_vec_t vecRanks;
+    std::vector<COutPoint> vecOutpoints;
+    BOOST_CHECK(man.GetMasternodeRanks(vecRanks, nBlockHeight, nMinProtocol));
+    for (const auto& rankpair : vecRanks) {
+        int nRank;
+        BOOST_CHECK(man.GetMasternodeRank(rankpair.second.vin.prevout, nRank, nBlockHeight, nMinProtocol));
+        BOOST_CHECK_EQUAL(nRank, rankpair.first);
+        BOOST_CHECK_EQUAL(rankpair.first, (int)vecOutpoints.size() + 1);
+        vecOutpoints.push_back(rankpair.second.vin.prevout);
+    }
+    return vecOutpoints;
+}
+
+// Reference implementation: score the whole list for the block at nBlockHeight, best first
+static std::vector<COutPoint> ReferenceRanks(CMasternodeMan& man, int nBlockHeight, int nMinProtocol)
+{
+    uint256 blockHash;
+    {
+        LOCK(cs_main);
+        blockHash = chainActive[nBlockHeight]->GetBlockHash();
+    }
+
+    std::vector<std::pair<arith_uint256, COutPoint> > vecScores;
+    for (const auto& mnpair : man.GetFullMasternodeMap()) {
+        if (mnpair.second.nProtocolVersion >= nMinProtocol)
+            vecScores.push_back(std::make_pair(mnpair.second.CalculateScore(blockHash), mnpair.first));
+    }
+    std::sort(vecScores.rbegin(), vecScores.rend());
+
+    std::vector<COutPoint> vecOutpoints;
+    for (const auto& scorepair : vecScores)
+        vecOutpoints.push_back(scorepair.second);
+    return vecOutpoints;
+}
+
+BOOST_FIXTURE_TEST_SUITE(masternode_tests, MasternodeTestingSetup)
+
+BOOST_AUTO_TEST_CASE(payment_queue)
+{
+    const int nMasternodes = 60;
+    const int nLevels = Params().CollateralLevels();
+
+    std::vector<CPubKey> vPubKeys;
+    for (int i = 0; i < nMasternodes; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        vPubKeys.push_back(key.GetPubKey());
+    }
+
+    // a payment to a random masternode in each of the blocks 150 to 164
+    std::map<int, CScript> mapPayees;
+    std::map<int, int> mapLastPaidExpected;
+    for (int nHeight = 150; nHeight < 165; nHeight++) {
+        int i = InsecureRandRange(nMasternodes);
+        mapPayees[nHeight] = GetScriptForDestination(vPubKeys[i].GetID());
+        mapLastPaidExpected[i] = nHeight;
+    }
+    BuildBranch(vBlocks, vHashes, nullptr, mapPayees);
+    SetTip(&vBlocks.back());
+    SetMockTime(vBlocks.back().GetBlockTime() + 1000);
+
+    const int nTipHeight = vBlocks.back().nHeight;
+    const int nMinProto = mnpayments.GetMinMasternodePaymentsProto();
+
+    CMasternodeMan man;
+    std::vector<COutPoint> vOutpoints;
+    std::vector<CMutableTransaction> vPending;
+    for (int i = 0; i < nMasternodes; i++) {
+        // every tier and some collateral amount that isn't one
+        int nTier = InsecureRandRange(nLevels + 1);
+        CAmount nAmount = nTier < nLevels ? Params().ValidCollateralAmounts()[nTier] * COIN : (Params().ValidCollateralAmounts()[0] - 1) * COIN;
+        CMutableTransaction tx = CollateralTx(nAmount, vPubKeys[i]);
+        COutPoint outpoint(tx.GetHash(), 0);
+        vOutpoints.push_back(outpoint);
+
+        if (InsecureRandRange(8) == 0) {
+            // not confirmed yet
+            vPending.push_back(tx);
+        } else {
+            // some without enough confirmations
+            LOCK(cs_main);
+            AddCoins(*pcoinsTip, CTransaction(tx), InsecureRandRange(8) ? InsecureRandRange(nTipHeight - 20) : nTipHeight - 5);
+        }
+
+        CMasternode mn = MakeMasternode(outpoint, vPubKeys[i], InsecureRandRange(10) ? nMinProto : nMinProto - 1);
+        // many masternodes paid at the same height, ordered by outpoint then
+        mn.nBlockLastPaid = InsecureRandRange(20) * 5;
+        mn.sigTime = GetAdjustedTime() - InsecureRandRange(nMasternodes * 6 * 60);
+        if (InsecureRandRange(8) == 0)
+            mn.nActiveState = InsecureRandBool() ? CMasternode::MASTERNODE_PRE_ENABLED : CMasternode::MASTERNODE_EXPIRED;
+        BOOST_CHECK(man.Add(mn));
+    }
+    CheckPaymentQueue(man, nTipHeight + 1);
+
+    // two votes for each payee, UpdateLastPaid finds the payments in the blocks
+    {
+        LOCK(cs_mapMasternodeBlocks);
+        for (const auto& payeepair : mapPayees) {
+            CMasternodePayee payee(payeepair.second, InsecureRand256());
+            payee.AddVoteHash(InsecureRand256());
+            CMasternodeBlockPayees blockPayees(payeepair.first);
+            blockPayees.vecPayees.push_back(payee);
+            mnpayments.mapMasternodeBlocks[payeepair.first] = blockPayees;
+        }
+    }
+    man.UpdateLastPaid(&vBlocks.back());
+    for (const auto& paidpair : mapLastPaidExpected) {
+        CMasternode mn;
+        BOOST_CHECK(man.Get(vOutpoints[paidpair.first], mn));
+        BOOST_CHECK_EQUAL(mn.GetLastPaidBlock(), paidpair.second);
+    }
+    CheckPaymentQueue(man, nTipHeight + 1);
+
+    // spent collaterals the masternode manager wasn't told about yet
+    CMutableTransaction txSpend;
+    for (const COutPoint& outpoint : vOutpoints) {
+        LOCK(cs_main);
+        if (InsecureRandRange(6) == 0 && pcoinsTip->SpendCoin(outpoint))
+            txSpend.vin.emplace_back(outpoint);
+    }
+    CheckPaymentQueue(man, nTipHeight + 1);
+
+    // a block confirming the pending collaterals and spending the others
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(txSpend));
+    for (const CMutableTransaction& tx : vPending) {
+        LOCK(cs_main);
+        AddCoins(*pcoinsTip, CTransaction(tx), nTipHeight - 20);
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    man.UpdateCollaterals(block);
+    CheckPaymentQueue(man, nTipHeight + 1);
+}
+
+BOOST_AUTO_TEST_CASE(rank_cache)
+{
+    BuildBranch(vBlocks, vHashes, nullptr);
+    SetTip(&vBlocks.back());
+    SetMockTime(vBlocks.back().GetBlockTime() + 1000);
+
+    const int nMinProto = mnpayments.GetMinMasternodePaymentsProto();
+    const int nHeight = 150;
+
+    CMasternodeMan man;
+    std::vector<CMasternode> vMasternodes;
+    for (int i = 0; i < 20; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        // a few of them below the protocol the ranks are asked for
+        CMasternode mn = MakeMasternode(COutPoint(InsecureRand256(), 0), key.GetPubKey(), i < 3 ? nMinProto - 1 : nMinProto);
+        // no collateral lookups on Check()
+        mn.fUnitTest = true;
+        BOOST_CHECK(man.Add(mn));
+        vMasternodes.push_back(mn);
+    }
+
+    std::vector<COutPoint> vecExpected = ReferenceRanks(man, nHeight, nMinProto);
+    BOOST_CHECK(GetRanks(man, nHeight, nMinProto) == vecExpected);
+    BOOST_CHECK_EQUAL(CMasternodeManTest::RankCacheSize(man), 1U);
+
+    // served from the cache as long as nothing changes
+    BOOST_CHECK(CMasternodeManTest::ReverseCachedRanks(man, nHeight, nMinProto));
+    std::reverse(vecExpected.begin(), vecExpected.end());
+    BOOST_CHECK(GetRanks(man, nHeight, nMinProto) == vecExpected);
+
+    // a new masternode
+    CKey key;
+    key.MakeNewKey(true);
+    CMasternode mnNew = MakeMasternode(COutPoint(InsecureRand256(), 0), key.GetPubKey(), nMinProto);
+    mnNew.fUnitTest = true;
+    BOOST_CHECK(man.Add(mnNew));
+    BOOST_CHECK_EQUAL(CMasternodeManTest::RankCacheSize(man), 0U);
+    vecExpected = ReferenceRanks(man, nHeight, nMinProto);
+    BOOST_CHECK(std::count(vecExpected.begin(), vecExpected.end(), mnNew.vin.prevout) == 1);
+    BOOST_CHECK(GetRanks(man, nHeight, nMinProto) == vecExpected);
+
+    // a new broadcast raising the protocol version of a known masternode
+    BOOST_CHECK(CMasternodeManTest::ReverseCachedRanks(man, nHeight, nMinProto));
+    CMasternodeBroadcast mnb(vMasternodes[0]);
+    mnb.sigTime++;
+    mnb.nProtocolVersion = nMinProto;
+    man.UpdateMasternodeList(mnb, *connman);
+    BOOST_CHECK_EQUAL(CMasternodeManTest::RankCacheSize(man), 0U);
+    vecExpected = ReferenceRanks(man, nHeight, nMinProto);
+    BOOST_CHECK(std::count(vecExpected.begin(), vecExpected.end(), mnb.vin.prevout) == 1);
+    BOOST_CHECK(GetRanks(man, nHeight, nMinProto) == vecExpected);
+
+    // a masternode removed because its collateral is gone
+    BOOST_CHECK(CMasternodeManTest::ReverseCachedRanks(man, nHeight, nMinProto));
+    CMasternode mnSpent = MakeMasternode(COutPoint(InsecureRand256(), 0), key.GetPubKey(), nMinProto);
+    BOOST_CHECK(man.Add(mnSpent));
+    man.CheckAndRemove(*connman);
+    BOOST_CHECK(!man.Has(mnSpent.vin.prevout));
+    BOOST_CHECK_EQUAL(CMasternodeManTest::RankCacheSize(man), 0U);
+    vecExpected = ReferenceRanks(man, nHeight, nMinProto);
+    // the new one is in, the two masternodes still below nMinProto are not
+    BOOST_CHECK_EQUAL(vecExpected.size(), vMasternodes.size() + 1 - 2);
+    BOOST_CHECK(GetRanks(man, nHeight, nMinProto) == vecExpected);
+
+    // a reorg replacing the block at nHeight, the cached entry is told apart by its block hash
+    std::vector<CBlockIndex> vBlocksFork(80);
+    std::vector<uint256> vHashesFork;
+    BuildBranch(vBlocksFork, vHashesFork, &vBlocks[nHeight - 11]);
+    BOOST_CHECK(CMasternodeManTest::ReverseCachedRanks(man, nHeight, nMinProto));
+    SetTip(&vBlocksFork.back());
+    vecExpected = ReferenceRanks(man, nHeight, nMinProto);
+    BOOST_CHECK(GetRanks(man, nHeight, nMinProto) == vecExpected);
+    BOOST_CHECK(CMasternodeManTest::RankCacheBlockHash(man, nHeight, nMinProto) == vBlocksFork[10].GetBlockHash());
+
+    // and back
+    BOOST_CHECK(CMasternodeManTest::ReverseCachedRanks(man, nHeight, nMinProto));
+    SetTip(&vBlocks.back());
+    vecExpected = ReferenceRanks(man, nHeight, nMinProto);
+    BOOST_CHECK(GetRanks(man, nHeight, nMinProto) == vecExpected);
+    BOOST_CHECK(CMasternodeManTest::RankCacheBlockHash(man, nHeight, nMinProto) == vBlocks[nHeight].GetBlockHash());
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_freshness)
+{
+    BuildBranch(vBlocks, vHashes, nullptr);
+    SetTip(&vBlocks.back());
+    SetMockTime(vBlocks.back().GetBlockTime() + 1000);
+
+    const int nMinProto = mnpayments.GetMinMasternodePaymentsProto();
+
+    CMasternodeMan man;
+    CKey keyCollateral;
+    keyCollateral.MakeNewKey(true);
+    const CScript payee = GetScriptForDestination(keyCollateral.GetPubKey().GetID());
+    CMasternode mn = MakeMasternode(COutPoint(InsecureRand256(), 0), keyCollateral.GetPubKey(), nMinProto);
+    // no collateral lookups on Check()
+    mn.fUnitTest = true;
+    masternode_info_t mnInfo;
+
+    // readers see a new masternode as soon as Add() returns
+    BOOST_CHECK(!man.Has(mn.vin.prevout));
+    BOOST_CHECK(man.Add(mn));
+    BOOST_CHECK(man.Has(mn.vin.prevout));
+    BOOST_CHECK(man.IsMasternodeCollateral(mn.vin.prevout));
+    BOOST_CHECK(man.GetMasternodeInfo(mn.vin.prevout, mnInfo));
+    BOOST_CHECK_EQUAL(mnInfo.nActiveState, CMasternode::MASTERNODE_ENABLED);
+    BOOST_CHECK(man.GetMasternodeInfo(mn.pubKeyMasternode, mnInfo));
+    BOOST_CHECK(mnInfo.vin.prevout == mn.vin.prevout);
+    BOOST_CHECK(man.GetMasternodeInfo(payee, mnInfo));
+    BOOST_CHECK(mnInfo.vin.prevout == mn.vin.prevout);
+
+    // state changes of Check(), never pinged so a new start is required
+    man.Check();
+    BOOST_CHECK(man.GetMasternodeInfo(mn.vin.prevout, mnInfo));
+    BOOST_CHECK_EQUAL(mnInfo.nActiveState, CMasternode::MASTERNODE_NEW_START_REQUIRED);
+
+    // changes made in place are there after the next Check(), even without a new state
+    CKey keyMasternode;
+    keyMasternode.MakeNewKey(true);
+    CMasternodeBroadcast mnb(mn);
+    mnb.sigTime++;
+    mnb.pubKeyMasternode = keyMasternode.GetPubKey();
+    man.UpdateMasternodeList(mnb, *connman);
+    man.Check();
+    BOOST_CHECK(man.GetMasternodeInfo(mn.vin.prevout, mnInfo));
+    BOOST_CHECK_EQUAL(mnInfo.nActiveState, CMasternode::MASTERNODE_NEW_START_REQUIRED);
+    BOOST_CHECK_EQUAL(mnInfo.sigTime, mnb.sigTime);
+    BOOST_CHECK(man.GetMasternodeInfo(keyMasternode.GetPubKey(), mnInfo));
+    BOOST_CHECK(mnInfo.vin.prevout == mn.vin.prevout);
+    BOOST_CHECK(!man.GetMasternodeInfo(mn.pubKeyMasternode, mnInfo));
+
+    // and gone as soon as CheckAndRemove() dropped it, here because its collateral is unknown
+    CMasternode mnSpent = MakeMasternode(COutPoint(InsecureRand256(), 0), keyCollateral.GetPubKey(), nMinProto);
+    BOOST_CHECK(man.Add(mnSpent));
+    BOOST_CHECK(man.Has(mnSpent.vin.prevout));
+    man.CheckAndRemove(*connman);
+    BOOST_CHECK(!man.Has(mnSpent.vin.prevout));
+    BOOST_CHECK(!man.IsMasternodeCollateral(mnSpent.vin.prevout));
+    BOOST_CHECK(!man.GetMasternodeInfo(mnSpent.vin.prevout, mnInfo));
+    BOOST_CHECK(!man.GetMasternodeInfo(mnSpent.pubKeyMasternode, mnInfo));
+    BOOST_CHECK(man.Has(mn.vin.prevout));
+    BOOST_CHECK_EQUAL(man.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(check_deadlines)
+{
+    BuildBranch(vBlocks, vHashes, nullptr);
+    SetTip(&vBlocks.back());
+    const int64_t nTime = vBlocks.back().GetBlockTime() + 1000;
+    SetMockTime(nTime);
+
+    const int nMinProto = mnpayments.GetMinMasternodePaymentsProto();
+
+    CMasternodeMan man;
+    std::map<COutPoint, int64_t> mapLastChecked;
+    for (int i = 0; i < 50; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        CMasternode mn = MakeMasternode(COutPoint(InsecureRand256(), 0), key.GetPubKey(), nMinProto);
+        // no collateral lookups on Check()
+        mn.fUnitTest = true;
+        mn.nTimeLastChecked = nTime - InsecureRandRange(2 * MASTERNODE_CHECK_SECONDS);
+        BOOST_CHECK(man.Add(mn));
+        mapLastChecked[mn.vin.prevout] = mn.nTimeLastChecked;
+    }
+
+    int64_t nNow = nTime;
+    for (; nNow < nTime + 3 * MASTERNODE_CHECK_SECONDS; nNow++) {
+        SetMockTime(nNow);
+        man.Check();
+        for (auto& checkedpair : mapLastChecked) {
+            // the entries that are due are checked and scheduled again, the others keep their deadline
+            if (checkedpair.second + MASTERNODE_CHECK_SECONDS <= nNow)
+                checkedpair.second = nNow;
+            CMasternode mn;
+            BOOST_CHECK(man.Get(checkedpair.first, mn));
+            BOOST_CHECK_EQUAL(mn.nTimeLastChecked, checkedpair.second);
+            BOOST_CHECK_EQUAL(CMasternodeManTest::CheckDeadline(man, checkedpair.first), checkedpair.second + MASTERNODE_CHECK_SECONDS);
+        }
+    }
+
+    // a new broadcast resets the entry, it is checked on the next tick
+    const COutPoint outpoint = mapLastChecked.begin()->first;
+    CMasternode mn;
+    BOOST_CHECK(man.Get(outpoint, mn));
+    CMasternodeBroadcast mnb(mn);
+    mnb.sigTime++;
+    man.UpdateMasternodeList(mnb, *connman);
+    BOOST_CHECK_EQUAL(CMasternodeManTest::CheckDeadline(man, outpoint), 0);
+    SetMockTime(nNow);
+    man.Check();
+    BOOST_CHECK(man.Get(outpoint, mn));
+    BOOST_CHECK_EQUAL(mn.nTimeLastChecked, nNow);
+    BOOST_CHECK_EQUAL(CMasternodeManTest::CheckDeadline(man, outpoint), nNow + MASTERNODE_CHECK_SECONDS);
+
+    // removed masternodes are not scheduled anymore
+    CKey key;
+    key.MakeNewKey(true);
+    CMasternode mnSpent = MakeMasternode(COutPoint(InsecureRand256(), 0), key.GetPubKey(), nMinProto);
+    BOOST_CHECK(man.Add(mnSpent));
+    BOOST_CHECK_EQUAL(CMasternodeManTest::CheckDeadline(man, mnSpent.vin.prevout), MASTERNODE_CHECK_SECONDS);
+    man.CheckAndRemove(*connman);
+    BOOST_CHECK(!man.Has(mnSpent.vin.prevout));
+    BOOST_CHECK_EQUAL(CMasternodeManTest::CheckDeadline(man, mnSpent.vin.prevout), -1);
+}
+
+BOOST_AUTO_TEST_CASE(broadcast_hash)
+{
+    for (int i = 0; i < 10; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        CMasternode mn = MakeMasternode(COutPoint(InsecureRand256(), InsecureRandRange(4)), key.GetPubKey(), PROTOCOL_VERSION);
+        mn.sigTime = InsecureRand32();
+        BOOST_CHECK(mn.GetBroadcastHash() == CMasternodeBroadcast(mn).GetHash());
+        // a newer broadcast only changes sigTime
+        mn.sigTime++;
+        BOOST_CHECK(mn.GetBroadcastHash() == CMasternodeBroadcast(mn).GetHash());
+        CMasternode mnCopy(mn);
+        BOOST_CHECK(mnCopy.GetBroadcastHash() == CMasternodeBroadcast(mn).GetHash());
+    }
+
+    // the list finds the broadcasts it has seen by the hash of the entry
+    CMasternodeMan man;
+    CKey key;
+    key.MakeNewKey(true);
+    CMasternodeBroadcast mnb(MakeMasternode(COutPoint(InsecureRand256(), 0), key.GetPubKey(), PROTOCOL_VERSION));
+    man.UpdateMasternodeList(mnb, *connman);
+    CMasternode mn;
+    BOOST_CHECK(man.Get(mnb.vin.prevout, mn));
+    BOOST_CHECK(mn.GetBroadcastHash() == mnb.GetHash());
+    BOOST_CHECK_EQUAL(man.mapSeenMasternodeBroadcast.count(mn.GetBroadcastHash()), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -13,14 +13,17 @@
 #include <policy/policy.h>
 #include <pubkey.h>
 #include <script/standard.h>
+#include <timedata.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include <validationinterface.h>
 
 #include <test/test_bitcoin.h>
 
 #include <memory>
+#include <thread>
 
 #include <boost/test/unit_test.hpp>
 
@@ -201,6 +204,68 @@ static void TestPackageSelection(const CChainParams& chainparams, const CScript&
     BOOST_CHECK(pblocktemplate->block.vtx[8]->GetHash() == hashLowFeeTx2);
 }
 
+// Test that an assembler kept across calls reuses its selection on the same tip.
+static void TestIncrementalTemplate(const CChainParams& chainparams, const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst) EXCLUSIVE_LOCKS_REQUIRED(::mempool.cs)
+{
+    TestMemPoolEntryHelper entry;
+    BlockAssembler assembler = AssemblerForTest(chainparams);
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout.hash = txFirst[0]->GetHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 5000000000LL - 10000;
+    uint256 hashLowFeeTx = tx.GetHash();
+    mempool.addUnchecked(hashLowFeeTx, entry.Fee(10000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+    CTransaction lowFeeTx(tx);
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate = assembler.CreateNewBlock(scriptPubKey);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == hashLowFeeTx);
+
+    // Nothing changed: same selection, fresh coinbase
+    CScript scriptPubKey2 = CScript() << OP_TRUE;
+    std::unique_ptr<CBlockTemplate> pblocktemplate2 = assembler.CreateNewBlock(scriptPubKey2);
+    BOOST_CHECK_EQUAL(pblocktemplate2->block.vtx.size(), 2U);
+    BOOST_CHECK(pblocktemplate2->block.vtx[1] == pblocktemplate->block.vtx[1]);
+    BOOST_CHECK(pblocktemplate2->block.vtx[0]->vout[0].scriptPubKey == scriptPubKey2);
+    BOOST_CHECK(pblocktemplate2->vTxFees == pblocktemplate->vTxFees);
+    BOOST_CHECK(pblocktemplate2->vTxSigOpsCost == pblocktemplate->vTxSigOpsCost);
+
+    // A new transaction with a lower fee comes after the previous selection
+    tx.vin[0].prevout.hash = txFirst[1]->GetHash();
+    tx.vout[0].nValue = 5000000000LL - 5000;
+    uint256 hashLowerFeeTx = tx.GetHash();
+    mempool.addUnchecked(hashLowerFeeTx, entry.Fee(5000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+    CTransaction lowerFeeTx(tx);
+    pblocktemplate = assembler.CreateNewBlock(scriptPubKey);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == hashLowFeeTx);
+    BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == hashLowerFeeTx);
+    mempool.removeRecursive(lowerFeeTx);
+
+    // A new transaction with a higher fee is selected first
+    tx.vin[0].prevout.hash = txFirst[2]->GetHash();
+    tx.vout[0].nValue = 5000000000LL - 50000;
+    uint256 hashHighFeeTx = tx.GetHash();
+    mempool.addUnchecked(hashHighFeeTx, entry.Fee(50000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+    pblocktemplate = assembler.CreateNewBlock(scriptPubKey);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == hashHighFeeTx);
+    BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == hashLowFeeTx);
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], -60000);
+
+    // A selected transaction leaving the mempool forces a full selection
+    mempool.removeRecursive(lowFeeTx);
+    pblocktemplate = assembler.CreateNewBlock(scriptPubKey);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == hashHighFeeTx);
+
+    mempool.clear();
+}
+
 // NOTE: These tests rely on CreateNewBlock doing its own self-validation!
 BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
 {
@@ -518,7 +583,41 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
 
     TestPackageSelection(chainparams, scriptPubKey, txFirst);
 
+    mempool.clear();
+    TestIncrementalTemplate(chainparams, scriptPubKey, txFirst);
+
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(stake_minter_wakeup)
+{
+    StakeMinterNotifier notifier;
+    int64_t nTimeTipChanged = 0;
+    const uint64_t nTipWakeups = GetStakeMinterStats().nTipWakeups;
+
+    // without a new tip the wait ends at the deadline
+    BOOST_CHECK(!notifier.Wait(GetAdjustedTime() - 1, nTimeTipChanged));
+    const int64_t nDeadline = GetAdjustedTime() + 1;
+    BOOST_CHECK(!notifier.Wait(nDeadline, nTimeTipChanged));
+    BOOST_CHECK(GetAdjustedTime() >= nDeadline);
+    BOOST_CHECK_EQUAL(GetStakeMinterStats().nTipWakeups, nTipWakeups);
+
+    // a new tip wakes a waiting minter long before its deadline
+    RegisterValidationInterface(&notifier);
+    const int64_t nTimeBefore = GetTimeMicros();
+    bool fTipChanged = false;
+    std::thread waiter([&] { fTipChanged = notifier.Wait(GetAdjustedTime() + 3600, nTimeTipChanged); });
+    GetMainSignals().UpdatedBlockTip(chainActive.Tip(), nullptr, false);
+    SyncWithValidationInterfaceQueue();
+    waiter.join();
+    UnregisterValidationInterface(&notifier);
+    BOOST_CHECK(fTipChanged);
+    BOOST_CHECK(nTimeTipChanged >= nTimeBefore);
+    BOOST_CHECK_EQUAL(GetStakeMinterStats().nTipWakeups, nTipWakeups + 1);
+
+    // the tip change is reported once
+    BOOST_CHECK(!notifier.Wait(GetAdjustedTime() - 1, nTimeTipChanged));
+    BOOST_CHECK_EQUAL(GetStakeMinterStats().nTipWakeups, nTipWakeups + 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
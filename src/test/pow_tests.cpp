@@ -2,11 +2,13 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <pow.h>
 #include <random.h>
 #include <util.h>
+#include <validation.h>
 #include <test/test_bitcoin.h>
 
 #include <boost/test/unit_test.hpp>
@@ -61,6 +63,28 @@ BOOST_AUTO_TEST_CASE(get_next_work_upper_limit_actual)
     BOOST_CHECK_EQUAL(CalculateNextWorkRequired(&pindexLast, nLastRetargetTime, chainParams->GetConsensus()), 0x1d00e1fdU);
 }
 
+/* GetNextWorkRequired remembers its result on the index, it must match a fresh computation */
+BOOST_AUTO_TEST_CASE(get_next_work_cached)
+{
+    LOCK(cs_main);
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockIndex> blocks(1000);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = i ? blocks[i - 1].nTime + InsecureRandRange(3 * params.nPowTargetSpacing) : 1500000000;
+        if (i && InsecureRandBool())
+            blocks[i].SetProofOfStake();
+        blocks[i].nBits = i ? GetNextWorkRequired(&blocks[i - 1], params, blocks[i].IsProofOfStake()) : UintToArith256(params.powLimit).GetCompact();
+    }
+
+    for (const CBlockIndex& block : blocks) {
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(&block, params, false), DualKGW3(&block, params));
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(&block, params, true), PoSWorkRequired(&block, params));
+        BOOST_CHECK(block.nNextWorkPoW && block.nNextWorkPoS);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
 {
     const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
@@ -0,0 +1,82 @@
+// Copyright (c) 2018 The 5G developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <stratum.h>
+#include <consensus/merkle.h>
+#include <streams.h>
+#include <utilstrencodings.h>
+#include <validation.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(stratum_tests, BasicTestingSetup)
+
+static CBlock BlockWithTransactions(size_t nTx)
+{
+    CBlock block;
+    block.nVersion = 0x20000000;
+    block.hashPrevBlock = InsecureRand256();
+    block.nTime = 1540000000;
+    block.nBits = 0x1e0fffff;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << 1000 << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 50 * COIN;
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    for (size_t i = 1; i < nTx; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i;
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(stratum_job_rebuild)
+{
+    std::vector<unsigned char> vchExtraNonce = ParseHex("0000000112345678");
+    BOOST_REQUIRE_EQUAL(vchExtraNonce.size(), STRATUM_EXTRANONCE1_SIZE + STRATUM_EXTRANONCE2_SIZE);
+
+    for (size_t nTx = 1; nTx <= 9; nTx++) {
+        CBlock block = BlockWithTransactions(nTx);
+        CStratumJob job(block, 1000);
+
+        size_t nLevels = 0;
+        while (((size_t)1 << nLevels) < nTx) nLevels++;
+        BOOST_CHECK_EQUAL(job.merkleBranch.size(), nLevels);
+
+        CBlock rebuilt = job.GetBlock(vchExtraNonce, block.nTime + 1, 42);
+        BOOST_CHECK_EQUAL(rebuilt.nTime, block.nTime + 1);
+        BOOST_CHECK_EQUAL(rebuilt.nNonce, 42U);
+        BOOST_CHECK(rebuilt.hashPrevBlock == block.hashPrevBlock);
+        BOOST_REQUIRE_EQUAL(rebuilt.vtx.size(), nTx);
+        for (size_t i = 1; i < nTx; i++) {
+            BOOST_CHECK(rebuilt.vtx[i] == block.vtx[i]);
+        }
+
+        // The coinbase a miner assembles is the one in the block
+        CDataStream ss(ParseHex(job.coinb1 + HexStr(vchExtraNonce) + job.coinb2), SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+        CMutableTransaction coinbase;
+        ss >> coinbase;
+        BOOST_CHECK(ss.empty());
+        BOOST_CHECK(coinbase.vin[0].scriptSig == (CScript() << 1000 << vchExtraNonce) + COINBASE_FLAGS);
+        BOOST_CHECK_EQUAL(coinbase.GetHash(), rebuilt.vtx[0]->GetHash());
+
+        // and its branch leads to the merkle root of the whole block
+        BOOST_CHECK_EQUAL(rebuilt.hashMerkleRoot, BlockMerkleRoot(rebuilt));
+        BOOST_CHECK(rebuilt.hashMerkleRoot != block.hashMerkleRoot);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
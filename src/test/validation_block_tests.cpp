@@ -4,6 +4,7 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <chain.h>
 #include <chainparams.h>
 #include <consensus/merkle.h>
 #include <consensus/validation.h>
@@ -13,6 +14,7 @@
 #include <test/test_bitcoin.h>
 #include <validation.h>
 #include <validationinterface.h>
+#include <versionbits.h>
 
 struct RegtestingSetup : public TestingSetup {
     RegtestingSetup() : TestingSetup(CBaseChainParams::REGTEST) {}
@@ -181,4 +183,68 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, chainActive.Tip()->GetBlockHash());
 }
 
+// a chain of headers on top of genesis whose proof of work is checked on acceptance
+static std::vector<CBlockHeader> HeaderChain(size_t count)
+{
+    std::vector<CBlockHeader> headers;
+    CBlockHeader prev = Params().GenesisBlock().GetBlockHeader();
+    for (size_t i = 0; i < count; i++) {
+        CBlockHeader header;
+        header.nVersion = VERSIONBITS_TOP_BITS;
+        header.hashPrevBlock = prev.GetHash();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = prev.nTime + 1;
+        header.nBits = prev.nBits;
+        header.nNonce = 1;
+        while (!CheckProofOfWork(header.GetPoWHash(), header.nBits, false, Params().GetConsensus())) {
+            ++header.nNonce;
+        }
+        headers.push_back(header);
+        prev = header;
+    }
+    return headers;
+}
+
+BOOST_AUTO_TEST_CASE(processnewblockheaders_pow)
+{
+    const std::vector<CBlockHeader> headers = HeaderChain(100);
+
+    // a batch whose first header does not connect is rejected up front
+    const std::vector<CBlockHeader> unconnected(headers.begin() + 1, headers.end());
+    CValidationState state_unconnected;
+    BOOST_CHECK(!ProcessNewBlockHeaders(unconnected, state_unconnected, Params()));
+    BOOST_CHECK_EQUAL(state_unconnected.GetRejectReason(), "prev-blk-not-found");
+
+    // a header that fails its proof of work in the middle of the batch is
+    // reported, and the headers before it are still accepted
+    std::vector<CBlockHeader> bad_headers(headers);
+    CBlockHeader& bad = bad_headers[60];
+    while (CheckProofOfWork(bad.GetPoWHash(), bad.nBits, false, Params().GetConsensus())) {
+        ++bad.nNonce;
+    }
+
+    CValidationState state;
+    CBlockHeader first_invalid;
+    BOOST_CHECK(!ProcessNewBlockHeaders(bad_headers, state, Params(), nullptr, &first_invalid));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_CHECK_EQUAL(first_invalid.GetHash(), bad.GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(mapBlockIndex.count(headers[59].GetHash()));
+        BOOST_CHECK(!mapBlockIndex.count(bad.GetHash()));
+    }
+
+    // the whole valid batch is accepted, including the already known headers
+    const CBlockIndex* pindex = nullptr;
+    CValidationState state2;
+    BOOST_CHECK(ProcessNewBlockHeaders(headers, state2, Params(), &pindex));
+    BOOST_REQUIRE(pindex);
+    BOOST_CHECK_EQUAL(pindex->GetBlockHash(), headers.back().GetHash());
+    LOCK(cs_main);
+    for (const CBlockHeader& header : headers) {
+        BOOST_REQUIRE(mapBlockIndex.count(header.GetHash()));
+        BOOST_CHECK(mapBlockIndex[header.GetHash()]->nStatus & BLOCK_POW_VALID);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
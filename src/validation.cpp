@@ -157,7 +157,8 @@ public:
     BlockMap mapBlockIndex;
     std::multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
     CBlockIndex *pindexBestInvalid = nullptr;
-    std::map<COutPoint, int> mapStakeSpent;
+    CStakeSpentIndex stakeSpentIndex;
+    CForkSpentIndex forkSpentIndex;
 
     bool LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree);
 
@@ -166,9 +167,10 @@ public:
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
+     * hashPoWChecked is the X16R hash of the header if the caller already computed it.
      */
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex);
-    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256& hashPoWChecked = uint256());
+    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256& hashPoWChecked = uint256());
 
     // Block (dis)connection on a given view:
     DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view);
@@ -234,6 +236,7 @@ bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
+bool fParanoidBlockReads = DEFAULT_PARANOID_BLOCK_READS;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
@@ -1108,7 +1111,7 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPoW)
 {
     block.SetNull();
 
@@ -1126,7 +1129,7 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     }
 
     // Check the header
-    if (block.IsProofOfWork() && !CheckProofOfWork(block.GetPoWHash(), block.nBits, false, consensusParams))
+    if (fCheckPoW && block.IsProofOfWork() && !CheckProofOfWork(block.GetPoWHash(), block.nBits, false, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
@@ -1135,16 +1138,45 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     CDiskBlockPos blockPos;
+    bool fCheckPoW;
+    bool fUpdateIndex;
     {
         LOCK(cs_main);
         blockPos = pindex->GetBlockPos();
+        fCheckPoW = fParanoidBlockReads || !(pindex->nStatus & BLOCK_POW_VALID);
+        fUpdateIndex = !(pindex->nStatus & BLOCK_POW_VALID) || pindex->hashPoW.IsNull();
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    // The block hash commits to the whole header, so once it matches the
+    // index the proof of work verified when the header was accepted holds
+    if (!ReadBlockFromDisk(block, blockPos, consensusParams, false))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
                      pindex->ToString(), pindex->GetBlockPos().ToString());
+    if (!fCheckPoW)
+        return true;
+
+    uint256 hashPoW;
+    if (block.IsProofOfWork()) {
+        hashPoW = block.GetPoWHash();
+        if (!CheckProofOfWork(hashPoW, block.nBits, false, consensusParams))
+            return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): Errors in block header at %s", blockPos.ToString());
+    }
+    if (fUpdateIndex) {
+        // index entries written before the flag existed are upgraded on first read,
+        // the hash is kept so that ConnectBlock doesn't compute it again
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(pindex->GetBlockHash());
+        if (mi != mapBlockIndex.end()) {
+            if (!(mi->second->nStatus & BLOCK_POW_VALID)) {
+                mi->second->nStatus |= BLOCK_POW_VALID;
+                setDirtyBlockIndex.insert(mi->second);
+            }
+            if (!hashPoW.IsNull())
+                mi->second->hashPoW = hashPoW;
+        }
+    }
     return true;
 }
 
@@ -1654,13 +1686,13 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-                // erase the spent input
-                mapStakeSpent.erase(out);
             }
         }
     }
 
+    // the inputs of this block are no longer spent
+    stakeSpentIndex.DisconnectBlock(block, pindex->nHeight);
+
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
@@ -1723,6 +1755,43 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure computing the proof of work hash of one block header. It always
+ * succeeds, the hash is compared to the target when the header is accepted,
+ * so an invalid header neither discards the hashes of the others nor has
+ * to be hashed again.
+ */
+class CPowCheck
+{
+private:
+    const CBlockHeader* pheader;
+    const Consensus::Params* pconsensusParams;
+    uint256* phashPoW;
+
+public:
+    CPowCheck(): pheader(nullptr), pconsensusParams(nullptr), phashPoW(nullptr) {}
+    CPowCheck(const CBlockHeader& header, const Consensus::Params& consensusParams, uint256* phashPoWIn) :
+        pheader(&header), pconsensusParams(&consensusParams), phashPoW(phashPoWIn) {}
+
+    bool operator()() {
+        *phashPoW = pheader->GetPoWHash();
+        return true;
+    }
+
+    void swap(CPowCheck& check) {
+        std::swap(pheader, check.pheader);
+        std::swap(pconsensusParams, check.pconsensusParams);
+        std::swap(phashPoW, check.phashPoW);
+    }
+};
+
+static CCheckQueue<CPowCheck> powcheckqueue(16);
+
+void ThreadPowCheck() {
+    RenameThread("5g-powcheck");
+    powcheckqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1857,7 +1926,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // is enforced in ContextualCheckBlockHeader(); we wouldn't want to
     // re-enforce that rule here (at least until we make it impossible for
     // GetAdjustedTime() to go backward).
-    if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck, !fJustCheck)) {
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck, !fJustCheck, true, &pindex->hashPoW)) {
         if (state.CorruptionPossible()) {
             // We don't write down blocks to disk if they may have been
             // corrupted, so this should be impossible unless we're having hardware
@@ -2151,26 +2220,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         }
     }
 
-    // add new entries
-    for (const CTransactionRef ptx: block.vtx) {
-        const CTransaction& tx = *ptx;
-        if (tx.IsCoinBase())
-            continue;
-        for (const CTxIn in: tx.vin) {
-            LogPrintf("mapStakeSpent: Insert %s | %u\n", in.prevout.ToString(), pindex->nHeight);
-            mapStakeSpent.insert(std::make_pair(in.prevout, pindex->nHeight));
-        }
-    }
-
-    // delete old entries
-    for (auto it = mapStakeSpent.begin(); it != mapStakeSpent.end();) {
-        if (it->second < pindex->nHeight - Params().MaxReorganizationDepth()) {
-            LogPrintf("mapStakeSpent: Erase %s | %u\n", it->first.ToString(), it->second);
-            it = mapStakeSpent.erase(it);
-        }else {
-            it++;
-        }
-    }
+    // remember recently spent outputs for stakes on forks
+    stakeSpentIndex.ConnectBlock(block, pindex->nHeight, chainparams.MaxReorganizationDepth());
 
     assert(pindex->phashBlock);
     // add this block to the view's block chain
@@ -3219,16 +3270,25 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+/**
+ * phashPoW, when given, holds the X16R hash of the header if the caller
+ * already knows it (null otherwise) and receives the hash once computed.
+ */
+static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, uint256* phashPoW = nullptr)
 {
     // Check proof of work matches claimed amount
-    if (block.nNonce && !CheckProofOfWork(block.GetPoWHash(), block.nBits, false, consensusParams))
-        return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+    if (block.nNonce) {
+        const uint256 hashPoW = (phashPoW && !phashPoW->IsNull()) ? *phashPoW : block.GetPoWHash();
+        if (phashPoW)
+            *phashPoW = hashPoW;
+        if (!CheckProofOfWork(hashPoW, block.nBits, false, consensusParams))
+            return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+    }
 
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckContractOutpoint)
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckContractOutpoint, uint256* phashPoW)
 {
     // These are checks that are independent of context.
 
@@ -3237,7 +3297,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW && block.IsProofOfWork()))
+    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW && block.IsProofOfWork(), phashPoW))
         return false;
 
     // Check the merkle root.
@@ -3551,11 +3611,12 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256& hashPoWChecked)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
     uint256 hash = block.GetHash();
+    uint256 hashPoW;
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -3569,7 +3630,9 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), (block.nNonce > 0)))
+        // a hash the caller computed and checked only costs a comparison here
+        hashPoW = hashPoWChecked;
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), (block.nNonce > 0), &hashPoW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3601,8 +3664,17 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             }
         }
     }
-    if (pindex == nullptr)
+    if (pindex == nullptr) {
         pindex = AddToBlockIndex(block);
+        // CheckBlockHeader above (or the caller) verified the proof of work
+        // of headers with a nonce, the genesis block is hard coded
+        if (block.nNonce || hash == chainparams.GetConsensus().hashGenesisBlock) {
+            pindex->nStatus |= BLOCK_POW_VALID;
+            setDirtyBlockIndex.insert(pindex);
+        }
+        // already computed for the check, keep it for when the block arrives
+        pindex->hashPoW = hashPoW;
+    }
 
     if (ppindex)
         *ppindex = pindex;
@@ -3615,13 +3687,51 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
     return true;
 }
 
+/**
+ * Compute the X16R hash of the headers that are not in the block index yet on
+ * the check queue threads, without holding cs_main. AcceptBlockHeader then
+ * only compares each hash to its target. Headers that ProcessNewBlockHeaders
+ * rejects before their proof of work is looked at are not hashed: all of them
+ * if the first one does not connect, and those from the first one older than
+ * the last checkpoint on.
+ */
+static std::vector<uint256> CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams)
+{
+    std::vector<uint256> vHashPoW(headers.size());
+    std::vector<CPowCheck> vChecks;
+    vChecks.reserve(headers.size());
+    {
+        LOCK(cs_main);
+        if (headers.empty() || !mapBlockIndex.count(headers[0].hashPrevBlock))
+            return vHashPoW;
+        const uint256 hashTip = chainActive.Tip()->GetBlockHash();
+        const CBlockIndex* pcheckpoint = Checkpoints::AutoSelectSyncCheckpoint();
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (headers[i].hashPrevBlock != hashTip && headers[i].GetBlockTime() < pcheckpoint->GetBlockTime())
+                break;
+            // Known headers return early from AcceptBlockHeader, don't hash them
+            if (headers[i].nNonce && !mapBlockIndex.count(headers[i].GetHash()))
+                vChecks.emplace_back(headers[i], consensusParams, &vHashPoW[i]);
+        }
+    }
+    if (vChecks.empty())
+        return vHashPoW;
+
+    CCheckQueueControl<CPowCheck> control(&powcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+    return vHashPoW;
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+    const std::vector<uint256> vHashPoW = CheckHeadersPoW(headers, chainparams.GetConsensus());
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
 
             // Check for the checkpoint
@@ -3637,7 +3747,7 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
                 }
             }
 
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, vHashPoW[i])) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3670,7 +3780,7 @@ static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CCh
 }
 
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
-bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock)
+bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256& hashPoWChecked)
 {
     const CBlock& block = *pblock;
 
@@ -3687,7 +3797,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
         return state.DoS(10, error("%s: prev block not found", __func__), 0, "prev-blk-not-found");
     pindexPrev = (*mi).second;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, hashPoWChecked))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -3749,47 +3859,21 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
             // the inputs are spent at the chain tip so we should look at the recently spent outputs
 
             for (CTxIn in : tx.vin) {
-                auto it = mapStakeSpent.find(in.prevout);
-                if (it == mapStakeSpent.end()) {
+                int nSpentHeight;
+                if (!stakeSpentIndex.GetSpentHeight(in.prevout, nSpentHeight)) {
                     return false;
                 }
-                if (it->second < pindexPrev->nHeight) {
+                if (nSpentHeight < pindexPrev->nHeight) {
                     return false;
                 }
             }
         }
 
-        // if this is on fork
-        if (!chainActive.Contains(pindexPrev) && pindexPrev != nullptr) {
-            // start at the block we're adding on to
-            CBlockIndex *last = pindexPrev;
-
-            // while that block is not on the main chain
-            while (!chainActive.Contains(last) && last != NULL) {
-                CBlock bl;
-                ReadBlockFromDisk(bl, last, Params().GetConsensus());
-                // loop through every spent input from said block
-
-                for (CTransactionRef tRef : bl.vtx) {
-                    const CTransaction& t = *tRef;
-                    for (CTxIn in : t.vin) {
-                        // loop through every spent input in the staking transaction of the new block
-
-                        const CTransaction& tx = *block.vtx[1];
-                        for (CTxIn stakeIn : tx.vin) {
-
-                            // if they spent the same input
-                            if (stakeIn.prevout == in.prevout) {
-                                // reject the block
-                                return false;
-                            }
-                        }
-                    }
-                }
-
-                // go to the parent block
-                last = last->pprev;
-            }
+        // if this is on fork, the stake must not spend an output that an
+        // earlier block of the same fork already spent
+        if (pindexPrev != nullptr && !chainActive.Contains(pindexPrev)) {
+            if (forkSpentIndex.IsSpentOnFork(tx, pindexPrev, chainActive, chainparams.GetConsensus()))
+                return false;
         }
     }
 
@@ -3806,6 +3890,9 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
         return AbortNode(state, std::string("System error: ") + e.what());
     }
 
+    forkSpentIndex.AddBlock(block, pindex);
+    forkSpentIndex.Prune(chainActive.Height() - chainparams.MaxReorganizationDepth());
+
     FlushStateToDisk(chainparams, state, FlushStateMode::NONE);
 
     CheckBlockIndex(chainparams.GetConsensus());
@@ -3821,15 +3908,24 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
         CBlockIndex *pindex = nullptr;
         if (fNewBlock) *fNewBlock = false;
         CValidationState state;
+        uint256 hashPoW;
+        {
+            // The header of a block we asked for after headers sync has
+            // already been hashed, don't compute X16R again in CheckBlock
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(pblock->GetHash());
+            if (mi != mapBlockIndex.end())
+                hashPoW = mi->second->hashPoW;
+        }
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
         // belt-and-suspenders.
-        bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
+        bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus(), true, true, true, &hashPoW);
 
         LOCK(cs_main);
 
         if (ret) {
             // Store to disk
-            ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock);
+            ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock, hashPoW);
         }
         if (!ret) {
             GetMainSignals().BlockChecked(*pblock, state);
@@ -4284,7 +4380,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
             return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
         // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus(), true, true, false))
+        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus(), true, true, false, &pindex->hashPoW))
             return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
                          pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
         // check level 2: verify undo validity
@@ -4540,6 +4636,8 @@ bool RewindBlockIndex(const CChainParams& params) {
 
 void CChainState::UnloadBlockIndex() {
     nBlockSequenceId = 1;
+    stakeSpentIndex.Clear();
+    forkSpentIndex.Clear();
     m_failed_blocks.clear();
     setBlockIndexCandidates.clear();
 }
@@ -4563,6 +4661,8 @@ void UnloadBlockIndex()
     for (int b = 0; b < VERSIONBITS_NUM_BITS; b++) {
         warningcache[b].clear();
     }
+    stakeModifierIndex.Clear();
+    stakeModifierCandidates.Clear();
 
     for (BlockMap::value_type& entry : mapBlockIndex) {
         delete entry.second;
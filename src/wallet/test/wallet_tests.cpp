@@ -10,7 +10,11 @@
 #include <utility>
 #include <vector>
 
+#include <arith_uint256.h>
+#include <chainparams.h>
 #include <consensus/validation.h>
+#include <kernel.h>
+#include <miner.h>
 #include <rpc/server.h>
 #include <test/test_bitcoin.h>
 #include <validation.h>
@@ -366,6 +370,123 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2U);
 }
 
+static std::set<COutPoint> StakeOutpoints(CWallet& wallet)
+{
+    std::vector<CStakeCandidate> candidates;
+    BOOST_CHECK(wallet.SelectStakeCoins(candidates, true));
+    std::set<COutPoint> outpoints;
+    for (const CStakeCandidate& candidate : candidates) {
+        outpoints.insert(candidate.outpoint);
+    }
+    return outpoints;
+}
+
+BOOST_FIXTURE_TEST_CASE(StakeCandidates, ListCoinsTestingSetup)
+{
+    RegisterValidationInterface(wallet.get());
+    std::set<COutPoint> before = StakeOutpoints(*wallet);
+    BOOST_CHECK(!before.empty());
+
+    // Spend a coin and mature the change, the candidates are only updated
+    // from validation notifications.
+    AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    for (int i = 0; i < Params().GetConsensus().nMinStakeHistory + 10; i++) {
+        CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    }
+    SyncWithValidationInterfaceQueue();
+    std::set<COutPoint> incremental = StakeOutpoints(*wallet);
+    BOOST_CHECK(incremental != before);
+
+    // A rescan rebuilds the candidates from the whole wallet.
+    {
+        WalletRescanReserver reserver(wallet.get());
+        reserver.reserve();
+        wallet->ScanForWalletTransactions(chainActive.Genesis(), nullptr, reserver);
+    }
+    BOOST_CHECK(StakeOutpoints(*wallet) == incremental);
+
+    UnregisterValidationInterface(wallet.get());
+}
+
+BOOST_FIXTURE_TEST_CASE(CreateCoinStakeThreads, ListCoinsTestingSetup)
+{
+    const Consensus::Params& consensus = Params().GetConsensus();
+    std::set<COutPoint> candidates = StakeOutpoints(*wallet);
+    BOOST_CHECK(!candidates.empty());
+
+    // every coin is past the minimum stake age and the hash drift of the search
+    SetMockTime(chainActive.Tip()->GetBlockTime() + consensus.nStakeMinAge + wallet->GetHashDrift() + 60);
+    gArgs.ForceSetArg("-stakethreads", "4");
+
+    CMutableTransaction coinbaseTx;
+    coinbaseTx.vin.resize(1);
+    coinbaseTx.vin[0].prevout.SetNull();
+    coinbaseTx.vout.resize(1);
+    coinbaseTx.vout[0].SetEmpty();
+
+    CBlock block;
+    // the easiest target, so the search finds a kernel on the first coins
+    block.nBits = UintToArith256(consensus.posLimit).GetCompact();
+    CMutableTransaction coinstakeTx;
+    unsigned int nTxNewTime = 0;
+    std::vector<const CWalletTx*> vwtxPrev;
+    BOOST_CHECK(wallet->CreateCoinStake(*wallet, block.nBits, 50 * COIN, coinstakeTx, nTxNewTime, vwtxPrev, false));
+    BOOST_REQUIRE_EQUAL(coinstakeTx.vin.size(), 1U);
+    BOOST_CHECK(candidates.count(coinstakeTx.vin[0].prevout));
+
+    block.nTime = nTxNewTime;
+    block.vtx.push_back(MakeTransactionRef(coinbaseTx));
+    block.vtx.push_back(MakeTransactionRef(coinstakeTx));
+    uint256 hashProofOfStake;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(CheckProofOfStake(block, hashProofOfStake, chainActive.Tip()));
+    }
+    BOOST_CHECK(!hashProofOfStake.IsNull());
+
+    gArgs.ForceSetArg("-stakethreads", std::to_string(DEFAULT_STAKE_THREADS));
+    SetMockTime(0);
+}
+
+BOOST_FIXTURE_TEST_CASE(MinerCoordinatorSlices, ListCoinsTestingSetup)
+{
+    const int nSlices = 3;
+    MinerCoordinator coordinator(Params(), wallet.get(), nSlices);
+    std::vector<MinerWork> vWork(nSlices + 1);
+    for (MinerWork& work : vWork) {
+        BOOST_REQUIRE(coordinator.GetWork(work));
+    }
+
+    // the slices of one extranonce share a block and cover the nonce space
+    // once, each starting at a multiple of 256
+    uint64_t nNonce = 0;
+    for (int i = 0; i < nSlices; i++) {
+        BOOST_CHECK(vWork[i].pblock == vWork[0].pblock);
+        BOOST_CHECK_EQUAL(vWork[i].nTemplate, vWork[0].nTemplate);
+        BOOST_CHECK_EQUAL(vWork[i].nNonceBegin, nNonce);
+        BOOST_CHECK_EQUAL(vWork[i].nNonceBegin % 256, 0U);
+        BOOST_CHECK(vWork[i].nNonceEnd > vWork[i].nNonceBegin);
+        nNonce = vWork[i].nNonceEnd;
+    }
+    BOOST_CHECK_EQUAL(nNonce, uint64_t(1) << 32);
+
+    // once all of them are handed out the next extranonce starts over
+    const MinerWork& next = vWork[nSlices];
+    BOOST_CHECK_EQUAL(next.nTemplate, vWork[0].nTemplate);
+    BOOST_CHECK_EQUAL(next.nNonceBegin, 0U);
+    BOOST_CHECK_EQUAL(next.nNonceEnd, vWork[0].nNonceEnd);
+    BOOST_CHECK(next.pblock != vWork[0].pblock);
+    BOOST_CHECK(next.pblock->hashMerkleRoot != vWork[0].pblock->hashMerkleRoot);
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height() + 1;
+    }
+    BOOST_CHECK(vWork[0].pblock->vtx[0]->vin[0].scriptSig == (CScript() << nHeight << CScriptNum(1)) + COINBASE_FLAGS);
+    BOOST_CHECK(next.pblock->vtx[0]->vin[0].scriptSig == (CScript() << nHeight << CScriptNum(2)) + COINBASE_FLAGS);
+    BOOST_CHECK(!coordinator.IsStale(next));
+}
+
 BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
 {
     std::shared_ptr<CWallet> wallet = std::make_shared<CWallet>(WalletLocation(), WalletDatabase::CreateDummy());
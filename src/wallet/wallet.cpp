@@ -37,6 +37,8 @@
 #include <algorithm>
 #include <assert.h>
 #include <future>
+#include <mutex>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -1123,6 +1125,9 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
 {
     LOCK2(cs_main, cs_wallet);
 
+    // outputs spent by the abandoned transactions become stakeable again
+    fStakeCandidatesDirty = true;
+
     WalletBatch batch(*database, "r+");
 
     std::set<uint256> todo;
@@ -1264,14 +1269,17 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
     }
+    UpdateStakeCandidates(*ptx);
 }
 
 void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
-    LOCK(cs_wallet);
+    LOCK2(cs_main, cs_wallet);
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = false;
     }
+    // outputs spent by an evicted transaction may stake again
+    UpdateStakeCandidates(*ptx);
 }
 
 void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
@@ -1292,6 +1300,7 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
         SyncTransaction(ptx);
         TransactionRemovedFromMempool(ptx);
     }
+    nStakeTipHeight = pindex->nHeight;
     for (size_t i = 0; i < pblock->vtx.size(); i++) {
         SyncTransaction(pblock->vtx[i], pindex, i);
         TransactionRemovedFromMempool(pblock->vtx[i]);
@@ -1303,8 +1312,76 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     LOCK2(cs_main, cs_wallet);
 
+    BlockMap::const_iterator mi = mapBlockIndex.find(pblock->GetHash());
+    if (mi != mapBlockIndex.end() && mi->second->pprev)
+        nStakeTipHeight = mi->second->pprev->nHeight;
     for (const CTransactionRef& ptx : pblock->vtx) {
         SyncTransaction(ptx);
+        UpdateStakeCandidates(*ptx);
+    }
+}
+
+void CWallet::UpdateStakeCandidate(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    mapStakeCandidates.erase(outpoint);
+
+    auto it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end())
+        return;
+
+    const CWalletTx& wtx = it->second;
+    if (outpoint.n >= wtx.tx->vout.size())
+        return;
+
+    const CTxOut& txout = wtx.tx->vout[outpoint.n];
+    if (txout.nValue < Params().GetConsensus().nMinStakeAmount)
+        return;
+
+    if (!(IsMine(txout) & ISMINE_SPENDABLE))
+        return;
+
+    CTxDestination dest;
+    if (!ExtractDestination(txout.scriptPubKey, dest))
+        return;
+
+    if (!boost::get<CKeyID>(&dest) && !boost::get<WitnessV0KeyHash>(&dest) &&
+            !boost::get<CScriptID>(&dest))
+        return;
+
+    // only unspent outputs confirmed in the active chain can stake
+    if (wtx.GetDepthInMainChain() <= 0 || IsSpent(outpoint.hash, outpoint.n))
+        return;
+
+    BlockMap::const_iterator mi = mapBlockIndex.find(wtx.hashBlock);
+    if (mi == mapBlockIndex.end())
+        return;
+
+    int nMaturity = (wtx.IsCoinBase() || wtx.IsCoinStake()) ? COINBASE_MATURITY + 1 : 10;
+    nMaturity = std::max(nMaturity, Params().GetConsensus().nMinStakeHistory);
+    mapStakeCandidates.emplace(outpoint, CStakeCandidate(outpoint, txout, mi->second, mi->second->GetBlockTime(),
+                                                         wtx.GetTxTime(), nMaturity, boost::get<CKeyID>(&dest) != nullptr));
+}
+
+void CWallet::UpdateStakeCandidates(const CTransaction& tx)
+{
+    AssertLockHeld(cs_wallet);
+
+    // picked up when the set is rebuilt
+    if (fStakeCandidatesDirty)
+        return;
+
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash))
+            UpdateStakeCandidate(txin.prevout);
+    }
+
+    const uint256 hash = tx.GetHash();
+    if (mapWallet.count(hash)) {
+        for (unsigned int i = 0; i < tx.vout.size(); i++)
+            UpdateStakeCandidate(COutPoint(hash, i));
     }
 }
 
@@ -1867,6 +1944,10 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
         }
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
+    {
+        LOCK(cs_wallet);
+        fStakeCandidatesDirty = true;
+    }
     return ret;
 }
 
@@ -2632,60 +2713,46 @@ bool CWallet::MintableCoins()
     return false;
 }
 
-bool CWallet::SelectStakeCoins(StakeCoinsSet &setCoins, CAmount nTargetAmount, bool fSelectWitness, const CScript &scriptFilterPubKey) const
+bool CWallet::SelectStakeCoins(std::vector<CStakeCandidate>& vCandidates, bool fSelectWitness)
 {
-    std::vector<COutput> vCoins;
-    CCoinControl coinControl;
-    coinControl.fAllowWatchOnly = !scriptFilterPubKey.empty();
+    bool fRebuild;
     {
-        LOCK2(cs_main, cs_wallet);
-        AvailableCoins(vCoins, !scriptFilterPubKey.empty(), &coinControl);
+        LOCK(cs_wallet);
+        fRebuild = fStakeCandidatesDirty;
     }
-    CAmount nAmountSelected = 0;
-
-    std::set<CScript> rejectCache;
-
-    for (const COutput& out : vCoins) {
-
-        CScript scriptPubKeyKernel;
-        scriptPubKeyKernel = out.tx->tx->vout[out.i].scriptPubKey;
-
-        if(!coinControl.fAllowWatchOnly && !out.fSpendable)
-            continue;
 
-        CTxDestination dest;
-        if(!ExtractDestination(scriptPubKeyKernel, dest))
-            continue;
-
-        if(!boost::get<CKeyID>(&dest) && !boost::get<WitnessV0KeyHash>(&dest) &&
-                !boost::get<CScriptID>(&dest))
-            continue;
-
-        if(!fSelectWitness && !boost::get<CKeyID>(&dest))
-            continue;
-
-        if (GetTime() - out.tx->GetTxTime() < Params().GetConsensus().nStakeMinAge)
-            continue;
+    if (fRebuild) {
+        LOCK2(cs_main, cs_wallet);
+        if (fStakeCandidatesDirty) {
+            fStakeCandidatesDirty = false;
+            mapStakeCandidates.clear();
+            nStakeTipHeight = chainActive.Height();
+            for (const auto& entry : mapWallet) {
+                for (unsigned int i = 0; i < entry.second.tx->vout.size(); i++)
+                    UpdateStakeCandidate(COutPoint(entry.first, i));
+            }
+            LogPrint(BCLog::KERNEL, "%s: rebuilt stake candidates, %u outputs\n", __func__, mapStakeCandidates.size());
+        }
+    }
 
-        if (out.nDepth < (out.tx->tx->IsCoinStake() ? COINBASE_MATURITY : 10))
-            continue;
+    LOCK(cs_wallet);
+    const int64_t nNow = GetTime();
+    for (const auto& entry : mapStakeCandidates) {
+        const CStakeCandidate& candidate = entry.second;
 
-        auto scriptPubKeyCoin = out.tx->tx->vout[out.i].scriptPubKey;
-        if(!scriptFilterPubKey.empty() && scriptPubKeyCoin != scriptFilterPubKey)
+        if (!fSelectWitness && !candidate.fKeyHash)
             continue;
 
-        if(rejectCache.count(scriptPubKeyCoin))
+        if (nNow - candidate.nTxTime < Params().GetConsensus().nStakeMinAge)
             continue;
 
-        if (out.nDepth < Params().GetConsensus().nMinStakeHistory)
+        if (nStakeTipHeight - candidate.pindexFrom->nHeight + 1 < candidate.nMaturity)
             continue;
 
-        if (out.tx->tx->vout[out.i].nValue < Params().GetConsensus().nMinStakeAmount)
+        if (IsLockedCoin(entry.first.hash, entry.first.n))
             continue;
 
-        nAmountSelected += out.tx->tx->vout[out.i].nValue;
-        setCoins.emplace(out.tx, out.i);
-
+        vCandidates.push_back(candidate);
     }
     return true;
 }
@@ -3301,46 +3368,66 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CTransac
 }
 
 bool CWallet::CreateCoinStakeKernel(CScript &kernelScript, const CScript &stakeScript,
-                                    unsigned int nBits, const CBlock &blockFrom,
-                                    unsigned int nTxPrevOffset, const CTransactionRef &txPrev,
-                                    const COutPoint &prevout, unsigned int &nTimeTx, bool fPrintProofOfStake) const
+                                    unsigned int nBits, const CBlockIndex* pindexFrom,
+                                    unsigned int nTxPrevOffset, CAmount nValueIn,
+                                    const COutPoint &prevout, unsigned int &nTimeTx, bool fPrintProofOfStake,
+                                    int64_t nMedianTimePast, const std::atomic<bool>* pfAbort,
+                                    unsigned int nTimeFrom) const
 {
-    unsigned int nTryTime = 0;
-    uint256 hashProofOfStake = uint256();
+    if (pindexFrom->GetBlockTime() + Params().GetConsensus().nStakeMinAge + nHashDrift > nTimeTx) // Min age requirement
+        return false;
 
-    if (blockFrom.GetBlockTime() + Params().GetConsensus().nStakeMinAge + nHashDrift > nTimeTx) // Min age requirement
+    // timestamps up to nTimeFrom were tried by an earlier search
+    unsigned int nTries = nHashDrift;
+    if (nTimeFrom) {
+        if (nTimeTx <= nTimeFrom)
+            return false;
+        nTries = std::min(nTries, nTimeTx - nTimeFrom);
+    }
+
+    CStakeKernelSearch search(nBits, pindexFrom, nTxPrevOffset, nValueIn, prevout);
+    if (!search.IsValid())
         return false;
 
-    for(unsigned int i = 0; i < nHashDrift; ++i)
+    const bool fStakeInfo = gArgs.GetBoolArg("-stakeinfo", false);
+    uint256 vHashes[CStakeKernelSearch::BATCH_SIZE];
+    for (unsigned int nBatch = 0; nBatch < nTries; nBatch += CStakeKernelSearch::BATCH_SIZE)
     {
-        nTryTime = nTimeTx - i;
-        bool stakeValid = CheckStakeKernelHash(nBits, blockFrom, nTxPrevOffset, txPrev, prevout, nTryTime, hashProofOfStake, true, false);
-        if (gArgs.GetBoolArg("-stakeinfo", false))
-            LogPrintf("%s - drift %03d prevout.hash %s prevout.n %02d hashProof %s\n", __func__, i, prevout.hash.ToString().c_str(), prevout.n, hashProofOfStake.ToString().c_str());
+        // another search thread already found a kernel
+        if (pfAbort && *pfAbort)
+            return false;
+
+        const size_t nCount = std::min<size_t>(CStakeKernelSearch::BATCH_SIZE, nTries - nBatch);
+        search.Hash(nTimeTx - nBatch, nCount, vHashes);
 
-        if (stakeValid)
+        for (size_t j = 0; j < nCount; ++j)
         {
-            //Double check that this will pass time requirements
-            if (nTryTime <= chainActive.Tip()->GetMedianTimePast()) {
-                LogPrintf("CreateCoinStakeKernel() : kernel found, but it is too far in the past \n");
-                continue;
+            const unsigned int i = nBatch + j;
+            const unsigned int nTryTime = nTimeTx - i;
+            if (fStakeInfo)
+                LogPrintf("%s - drift %03d prevout.hash %s prevout.n %02d hashProof %s\n", __func__, i, prevout.hash.ToString().c_str(), prevout.n, vHashes[j].ToString().c_str());
+
+            if (search.CheckTarget(nTryTime, vHashes[j]))
+            {
+                //Double check that this will pass time requirements
+                if (nTryTime <= nMedianTimePast) {
+                    LogPrintf("CreateCoinStakeKernel() : kernel found, but it is too far in the past \n");
+                    continue;
+                }
+                // Found a kernel
+                LogPrintf("CreateCoinStakeKernel : kernel found\n");
+                kernelScript.clear();
+                kernelScript = stakeScript;
+                nTimeTx = nTryTime;
+                return true;
             }
-            // Found a kernel
-            LogPrintf("CreateCoinStakeKernel : kernel found\n");
-            kernelScript.clear();
-            kernelScript = stakeScript;
-            nTimeTx = nTryTime;
-            return true;
         }
     }
     return false;
 }
 
-void CWallet::FillCoinStakePayments(CMutableTransaction &transaction, const CScript &scriptPubKeyOut, const COutPoint &stakePrevout, CAmount blockReward) const
+void CWallet::FillCoinStakePayments(CMutableTransaction &transaction, const CScript &scriptPubKeyOut, const COutPoint &stakePrevout, CAmount nCredit, CAmount blockReward) const
 {
-    const CWalletTx *walletTx = GetWalletTx(stakePrevout.hash);
-    CTxOut prevTxOut = walletTx->tx->vout[stakePrevout.n];
-    auto nCredit = prevTxOut.nValue;
     unsigned int percentage = 100;
 
     auto nCoinStakeReward = nCredit + GetStakeReward(blockReward, percentage);
@@ -3385,7 +3472,9 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore,
                               CMutableTransaction &txNew,
                               unsigned int &nTxNewTime,
                               std::vector<const CWalletTx*> &vwtxPrev,
-                              bool fGenerateSegwit)
+                              bool fGenerateSegwit,
+                              int64_t nSearchFrom,
+                              bool* pfSearched)
 {
     // The following split & combine thresholds are important to security
     // Should not be adjusted if you don't understand the consequences
@@ -3399,75 +3488,100 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore,
     txNew.vout.push_back(CTxOut(0, scriptEmpty));
 
     // Choose coins to use
-    CAmount nBalance = GetBalance();
-
-    // presstab HyperStake - Initialize as static and don't update the set on every run of CreateCoinStake() in order to lighten resource use
-    static StakeCoinsSet setStakeCoins;
-    static int nLastStakeSetUpdate = 0;
+    std::vector<CStakeCandidate> vStakeCoins;
+    if (!SelectStakeCoins(vStakeCoins, fGenerateSegwit))
+        return error("Failed to select coins for staking");
 
-    if (GetTime() - nLastStakeSetUpdate > nStakeSetUpdateTime) {
-        setStakeCoins.clear();
+    if (vStakeCoins.empty()) {
+        LogPrint(BCLog::KERNEL, "CreateCoinStake() : No Coins to stake\n");
+        return false;
+    }
 
-        CScript scriptPubKey;
+    // The search threads don't take cs_main, read what they need from the
+    // chain and bring the stake modifier index up to date beforehand
+    int64_t nMedianTimePast;
+    {
+        LOCK(cs_main);
+        // a block at this time would not be accepted, the stake minter waits
+        // for the first valid timestamp instead of searching now
+        if (GetAdjustedTime() <= chainActive.Tip()->nTime)
+            return false;
+        nMedianTimePast = chainActive.Tip()->GetMedianTimePast();
+        stakeModifierIndex.Sync(chainActive);
+    }
+    if (pfSearched)
+        *pfSearched = true;
+
+    // A coin that was too young to stake when the previous search ran has
+    // the whole hash drift window searched, not only the newer timestamps
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    auto coinSearchFrom = [&](const CStakeCandidate& candidate) -> int64_t {
+        if (nSearchFrom - candidate.nTxTime < consensusParams.nStakeMinAge ||
+                candidate.nBlockTime + consensusParams.nStakeMinAge + nHashDrift > nSearchFrom)
+            return 0;
+        return nSearchFrom;
+    };
+
+    // Each search thread takes the next untried coin and tries all of its
+    // drift times; all of them stop once any thread found a kernel
+    std::atomic<size_t> nNextCoin{0};
+    std::atomic<bool> fKernelFound{false};
+    std::mutex mutexKernel;
+    size_t nKernelCoin = 0;
+    unsigned int nKernelTime = 0;
+    CScript kernelScript;
+
+    auto searchCoins = [&]() {
+        while (!fKernelFound) {
+            const size_t i = nNextCoin++;
+            if (i >= vStakeCoins.size())
+                break;
 
-        if (!SelectStakeCoins(setStakeCoins, nBalance /*- nReserveBalance*/, fGenerateSegwit, scriptPubKey)) {
-            return error("Failed to select coins for staking");
+            // only the candidate's own copy of the output is read, the wallet
+            // may change while the threads search
+            const CStakeCandidate& candidate = vStakeCoins[i];
+            unsigned int nTimeTx = GetAdjustedTime();
+            CScript script;
+            if (CreateCoinStakeKernel(script, candidate.txout.scriptPubKey, nBits, candidate.pindexFrom,
+                                      sizeof(CBlock), candidate.txout.nValue, candidate.outpoint, nTimeTx, false, nMedianTimePast, &fKernelFound, coinSearchFrom(candidate)))
+            {
+                std::lock_guard<std::mutex> lock(mutexKernel);
+                if (!fKernelFound) {
+                    nKernelCoin = i;
+                    nKernelTime = nTimeTx;
+                    kernelScript = script;
+                    fKernelFound = true;
+                }
+            }
         }
+    };
 
-        LogPrintf("Selected %d coins for staking\n", setStakeCoins.size());
-
-        nLastStakeSetUpdate = GetTime();
-    }
+    int nThreads = gArgs.GetArg("-stakethreads", DEFAULT_STAKE_THREADS);
+    if (nThreads <= 0)
+        nThreads = GetNumCores();
+    nThreads = std::max(1, std::min<int>({nThreads, MAX_STAKE_THREADS, (int)vStakeCoins.size()}));
 
-    if (setStakeCoins.empty())
-        return error("CreateCoinStake() : No Coins to stake");
+    std::vector<std::thread> vSearchThreads;
+    for (int i = 1; i < nThreads; i++)
+        vSearchThreads.emplace_back(searchCoins);
+    searchCoins();
+    for (std::thread& thread : vSearchThreads)
+        thread.join();
 
-    CScript scriptPubKeyKernel;
-
-    //prevent staking a time that won't be accepted
-    if (GetAdjustedTime() <= chainActive.Tip()->nTime)
-        MilliSleep(10000);
-
-    bool fKernelFound = false;
-    for(const std::pair<const CWalletTx*, unsigned int> &pcoin : setStakeCoins)
-    {
-        //make sure that enough time has elapsed between
-        CBlockIndex* pindex = NULL;
-        BlockMap::iterator it = mapBlockIndex.find(pcoin.first->hashBlock);
-        if (it != mapBlockIndex.end())
-            pindex = it->second;
-        else {
-            LogPrintf("failed to find block index ");
-            continue;
-        }
-        // Read block header
-        CBlockHeader block = pindex->GetBlockHeader();
-        COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-        nTxNewTime = GetAdjustedTime();
-        //iterates each utxo inside of CheckStakeKernelHash()
-        CScript kernelScript;
-        auto stakeScript = pcoin.first->tx->vout[pcoin.second].scriptPubKey;
-        fKernelFound = CreateCoinStakeKernel(kernelScript, stakeScript, nBits,
-                                             block, sizeof(CBlock), pcoin.first->tx,
-                                             prevoutStake, nTxNewTime, false);
-        if(fKernelFound)
-        {
-            FillCoinStakePayments(txNew, kernelScript, prevoutStake, blockReward);
-            break;
-        }
-    }
     if(!fKernelFound)
     {
-        LogPrintf("Failed to find coinstake kernel");
+        LogPrint(BCLog::KERNEL, "CreateCoinStake() : no kernel found in %u coins\n", vStakeCoins.size());
         return false;
     }
 
+    nTxNewTime = nKernelTime;
+    FillCoinStakePayments(txNew, kernelScript, vStakeCoins[nKernelCoin].outpoint, vStakeCoins[nKernelCoin].txout.nValue, blockReward);
+
     // Update coinbase transaction with additional info about masternode and governance payments,
     // get some info back to pass to getblocktemplate
     CTxOut txoutMasternode;
     std::vector<CTxOut> voutSuperblock;
     int nHeight = chainActive.Tip()->nHeight + 1;
-    nLastStakeSetUpdate = 0; //this will trigger stake set to repopulate next round
     return true;
 }
 
@@ -3595,6 +3709,10 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     for (uint256 hash : vHashOut)
         mapWallet.erase(hash);
 
+    // candidates point into mapWallet
+    mapStakeCandidates.clear();
+    fStakeCandidatesDirty = true;
+
     if (nZapSelectTxRet == DBErrors::NEED_REWRITE)
     {
         if (database->Rewrite("\x04pool"))
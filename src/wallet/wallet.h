@@ -63,6 +63,10 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -stakethreads default
+static const int DEFAULT_STAKE_THREADS = 1;
+//! Maximum number of threads searching for a coinstake kernel
+static const int MAX_STAKE_THREADS = 16;
 
 static const int64_t TIMESTAMP_MIN = 0;
 
@@ -556,6 +560,34 @@ public:
     }
 };
 
+/**
+ * A wallet output that may be used as a stake kernel. The output and the block
+ * it was confirmed in are copied when the output is added to the wallet's stake
+ * candidates, so the stake search needs neither cs_main nor cs_wallet.
+ */
+class CStakeCandidate
+{
+public:
+    COutPoint outpoint;
+    CTxOut txout;
+    const CBlockIndex *pindexFrom;
+    int64_t nBlockTime;
+
+    /** Wallet time of the transaction, checked against the minimum stake age */
+    int64_t nTxTime;
+
+    /** Depth the output needs before it may stake */
+    int nMaturity;
+
+    /** Whether the output pays to a plain key hash; other types only stake with segwit enabled */
+    bool fKeyHash;
+
+    CStakeCandidate(const COutPoint &outpointIn, const CTxOut &txoutIn, const CBlockIndex *pindexFromIn, int64_t nBlockTimeIn, int64_t nTxTimeIn, int nMaturityIn, bool fKeyHashIn)
+        : outpoint(outpointIn), txout(txoutIn), pindexFrom(pindexFromIn), nBlockTime(nBlockTimeIn), nTxTime(nTxTimeIn), nMaturity(nMaturityIn), fKeyHash(fKeyHashIn)
+    {
+    }
+};
+
 
 
 
@@ -710,7 +742,19 @@ private:
     // Stake Settings
     unsigned int nHashDrift = 180;
     unsigned int nHashInterval = 22;
-    int nStakeSetUpdateTime = 300; // 5 mins
+
+    /**
+     * Outputs that may be used for staking, kept up to date from validation
+     * notifications instead of being reselected from AvailableCoins.
+     */
+    std::map<COutPoint, CStakeCandidate> mapStakeCandidates;
+    //! Set when mapStakeCandidates has to be rebuilt from the whole wallet (e.g. after a rescan)
+    bool fStakeCandidatesDirty = true;
+    //! Height of the last block the wallet was notified about, for stake maturity
+    int nStakeTipHeight = 0;
+
+    void UpdateStakeCandidate(const COutPoint& outpoint);
+    void UpdateStakeCandidates(const CTransaction& tx);
 
     mutable bool fAnonymizableTallyCached;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCached;
@@ -744,12 +788,15 @@ private:
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey& secret, bool internal = false);
     bool CreateCoinStakeKernel(CScript &kernelScript, const CScript &stakeScript,
-                               unsigned int nBits, const CBlock& blockFrom,
-                               unsigned int nTxPrevOffset, const CTransactionRef &txPrev,
-                               const COutPoint& prevout, unsigned int &nTimeTx, bool fPrintProofOfStake) const;
+                               unsigned int nBits, const CBlockIndex* pindexFrom,
+                               unsigned int nTxPrevOffset, CAmount nValueIn,
+                               const COutPoint& prevout, unsigned int &nTimeTx, bool fPrintProofOfStake,
+                               int64_t nMedianTimePast, const std::atomic<bool>* pfAbort = nullptr,
+                               unsigned int nTimeFrom = 0) const;
     void FillCoinStakePayments(CMutableTransaction &transaction,
                                const CScript &kernelScript,
-                               const COutPoint &stakePrevout, CAmount blockReward) const;
+                               const COutPoint &stakePrevout, CAmount nCredit,
+                               CAmount blockReward) const;
 
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool;
@@ -895,9 +942,8 @@ public:
     bool SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, std::vector<OutputGroup> groups, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CoinSelectionParams& coin_selection_params, bool& bnb_used) const;
 
     // Coin selection
-    using StakeCoinsSet = std::set<std::pair<const CWalletTx*, unsigned int>>;
     bool MintableCoins();
-    bool SelectStakeCoins(StakeCoinsSet& setCoins, CAmount nTargetAmount, bool fSelectWitness, const CScript &scriptFilterPubKey = CScript()) const;
+    bool SelectStakeCoins(std::vector<CStakeCandidate>& vCandidates, bool fSelectWitness);
     bool SelectCoinsGrouppedByAddresses(std::vector<CompactTallyItem>& vecTallyRet, bool fSkipDenominated = true, bool fAnonymizable = true, bool fSkipUnconfirmed = true) const;
 
 #if 0
@@ -1036,10 +1082,16 @@ public:
      */
     bool CreateTransaction(const std::vector<CRecipient>& vecSend, CTransactionRef& tx, CReserveKey& reservekey, CAmount& nFeeRet, int& nChangePosInOut,
                            std::string& strFailReason, const CCoinControl& coin_control, bool sign = true, OnTransactionToBeSigned onTxToBeSigned = OnTransactionToBeSigned());
+    //! When nSearchFrom is set, the timestamps up to it were searched before or are
+    //! not valid on the tip, and are skipped for the coins that could stake at that
+    //! time. pfSearched is set when the kernel search ran, found or not.
     bool CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, CAmount blockReward,
                          CMutableTransaction& txNew, unsigned int& nTxNewTime,
                          std::vector<const CWalletTx *> &vwtxPrev,
-                         bool fGenerateSegwit);
+                         bool fGenerateSegwit,
+                         int64_t nSearchFrom = 0, bool* pfSearched = nullptr);
+    //! Seconds before the coinstake time that CreateCoinStake searches as well
+    unsigned int GetHashDrift() const { return nHashDrift; }
     bool CommitTransaction(CTransactionRef tx, mapValue_t mapValue, std::vector<std::pair<std::string, std::string>> orderForm, std::string fromAccount, CReserveKey& reservekey, CConnman* connman, CValidationState& state);
 
     void ListAccountCreditDebit(const std::string& strAccount, std::list<CAccountingEntry>& entries);
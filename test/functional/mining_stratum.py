@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The 5G developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the built-in stratum server with a stub miner.
+
+The stub cannot compute X16R, it relies on the regtest target accepting about
+half of all hashes and submits nonces until one of them is a block."""
+
+import json
+import socket
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, p2p_port, wait_until
+
+class StratumMiner():
+    def __init__(self, port):
+        self.sock = socket.create_connection(('127.0.0.1', port), timeout=30)
+        self.buf = b''
+        self.notifications = []
+        self.next_id = 1
+
+    def read_message(self):
+        while b'\n' not in self.buf:
+            data = self.sock.recv(4096)
+            assert data, 'stratum connection closed'
+            self.buf += data
+        line, self.buf = self.buf.split(b'\n', 1)
+        return json.loads(line.decode())
+
+    def request(self, method, params):
+        request_id = self.next_id
+        self.next_id += 1
+        self.sock.sendall((json.dumps({'id': request_id, 'method': method, 'params': params}) + '\n').encode())
+        while True:
+            msg = self.read_message()
+            if msg['id'] is None:
+                self.notifications.append(msg)
+            else:
+                assert_equal(msg['id'], request_id)
+                return msg['result'], msg['error']
+
+    def wait_for(self, method):
+        while True:
+            while self.notifications:
+                msg = self.notifications.pop(0)
+                if msg['method'] == method:
+                    return msg['params']
+            self.notifications.append(self.read_message())
+
+def stratum_prevhash(blockhash):
+    """Block hash as stratum sends it: internal byte order, 32-bit words swapped"""
+    raw = bytes.fromhex(blockhash)[::-1]
+    return b''.join(raw[i:i + 4][::-1] for i in range(0, 32, 4)).hex()
+
+class StratumTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        port = p2p_port(self.num_nodes)
+        address = node.getnewaddress()
+        self.restart_node(0, ['-stratum', '-stratumport=%d' % port, '-stratumaddress=%s' % address])
+
+        self.log.info("Subscribe and authorize")
+        miner = StratumMiner(port)
+        result, error = miner.request('mining.submit', ['worker', '1', '00000000', '00000000', '00000000'])
+        assert_equal(error[0], 24)
+        result, error = miner.request('mining.subscribe', ['stub'])
+        assert_equal(error, None)
+        extranonce1, extranonce2_size = result[1], result[2]
+        assert_equal(len(extranonce1), 8)
+        assert_equal(extranonce2_size, 4)
+        result, error = miner.request('mining.authorize', ['worker', 'x'])
+        assert_equal(result, True)
+
+        difficulty = miner.wait_for('mining.set_difficulty')
+        assert difficulty[0] > 0
+        job = miner.wait_for('mining.notify')
+        assert_equal(job[1], stratum_prevhash(node.getbestblockhash()))
+        assert_equal(job[4], [])
+        assert_equal(job[8], True)
+
+        self.log.info("Reject malformed and low difficulty shares")
+        result, error = miner.request('mining.submit', ['worker', job[0], '00', job[7], '00000000'])
+        assert_equal(error[0], 20)
+        result, error = miner.request('mining.submit', ['worker', 'ffffffff', '00000000', job[7], '00000000'])
+        assert_equal(error[0], 21)
+
+        self.log.info("Mine a block through stratum")
+        height = node.getblockcount()
+        for nonce in range(256):
+            result, error = miner.request('mining.submit', ['worker', job[0], '00000001', job[7], '%08x' % nonce])
+            if result:
+                break
+            assert_equal(error[0], 23)
+        assert_equal(result, True)
+        wait_until(lambda: node.getblockcount() == height + 1, timeout=30)
+        coinbase = node.getblock(node.getbestblockhash(), 2)['tx'][0]
+        assert address in coinbase['vout'][0]['scriptPubKey']['addresses']
+
+        self.log.info("New tip cleans the jobs")
+        while True:
+            new_job = miner.wait_for('mining.notify')
+            if new_job[1] == stratum_prevhash(node.getbestblockhash()):
+                break
+        assert_equal(new_job[8], True)
+        result, error = miner.request('mining.submit', ['worker', job[0], '00000002', job[7], '00000000'])
+        assert_equal(error[0], 21)
+
+if __name__ == '__main__':
+    StratumTest().main()